@@ -18,6 +18,7 @@
  */
 
 #include <math.h>
+#include <string.h>
 #include <vector>
 
 #include "libXBMC_addon.h"
@@ -31,24 +32,37 @@
 
 #include "AudioDSPBasic.h"
 #include "AudioDSPSoundTest.h"
+#include "AudioDSPCalibration.h"
+#include "filter/mkfilter.h"
+#include "filter/filter.h"
 
 #include "GUIDialogSpeakerGain.h"
 #include "GUIDialogSpeakerDistance.h"
 
+#if !defined(M_PI) && defined(TARGET_WINDOWS)
+  #define _USE_MATH_DEFINES
+  #include <cmath>
+#endif
+
 using namespace std;
 using namespace ADDON;
 
-std::string GetSettingsFile()
+std::string GetSettingsFile(int profile)
 {
+  /* the first profile keeps the file name of the single calibration before */
+  CStdString fileName = "ADSPBasicAddonSettings.xml";
+  if (profile > 0)
+    fileName.Format("ADSPBasicAddonSettings_Profile%i.xml", profile + 1);
+
   string settingFile = g_strUserPath;
   if (settingFile.at(settingFile.size() - 1) == '\\' ||
       settingFile.at(settingFile.size() - 1) == '/')
-    settingFile.append("ADSPBasicAddonSettings.xml");
+    settingFile.append(fileName);
   else
 #if defined(TARGET_WINDOWS)
-    settingFile.append("\\ADSPBasicAddonSettings.xml");
+    settingFile.append("\\" + fileName);
 #else
-    settingFile.append("/ADSPBasicAddonSettings.xml");
+    settingFile.append("/" + fileName);
 #endif
   return settingFile;
 }
@@ -71,10 +85,25 @@ cDSPProcessorStream *g_usedDSPs[AE_DSP_STREAM_MAX_STREAMS];
 
 cDSPProcessorStream::cDSPProcessorStream(AE_DSP_STREAM_ID id)
   : m_StreamID(id)
+  , m_Profile(0)
+  , m_Compressor(NULL)
+  , m_LoudnessMeter(NULL)
+  , m_LoudnessGainDB(0.0f)
+  , m_MasterTailLeft(0)
+  , m_CompressorTailLeft(0)
+  , m_DialogueTailLeft(0)
+  , m_Dialogue(NULL)
+  , m_PostProcessKernel(&cDSPProcessorStream::PostProcessChannels<false>)
   , m_SoundTest(NULL)
   , m_MasterCurrrentMode(NULL)
+  , m_MasterPipeline(NULL)
 {
+  m_Preset = CDSPStreamPresetResolver::GetDefault();
+
   memset(m_Delay, 0, sizeof(m_Delay));
+  memset(m_AllPass, 0, sizeof(m_AllPass));
+  memset(m_ProfileRouting, 0, sizeof(m_ProfileRouting));
+  memset(&m_Routing, 0, sizeof(m_Routing));
 }
 
 cDSPProcessorStream::~cDSPProcessorStream()
@@ -85,7 +114,19 @@ cDSPProcessorStream::~cDSPProcessorStream()
   {
     if (m_Delay[i] != NULL)
       delete m_Delay[i];
+    for (int profile = 0; profile < SPEAKER_PROFILES; ++profile)
+    {
+      if (m_AllPass[profile][i] != NULL)
+        delete m_AllPass[profile][i];
+    }
   }
+
+  if (m_Compressor)
+    delete m_Compressor;
+  if (m_LoudnessMeter)
+    delete m_LoudnessMeter;
+  if (m_Dialogue)
+    delete m_Dialogue;
 }
 
 
@@ -124,19 +165,25 @@ AE_DSP_ERROR cDSPProcessorStream::StreamCreate(const AE_DSP_SETTINGS *settings,
 
   g_DSPProcessor.SetOutChannelPresentFlags(settings->lOutChannelPresentFlags);
 
-  for (masterModesMap::iterator it = g_DSPProcessor.m_MasterModesMap.begin(); it != g_DSPProcessor.m_MasterModesMap.end(); it++)
   {
-    if (it->second->IsSupported(settings, pProperties))
+    CLockObject lock(g_DSPProcessor.m_Mutex);
+    if (g_DSPProcessor.m_StreamPresets)
+      m_Preset = g_DSPProcessor.m_PresetResolver.Resolve(m_iStreamType, m_strCodecId, m_iChannels);
+    else
+      m_Preset = CDSPStreamPresetResolver::GetDefault();
+  }
+  KODI->Log(LOG_INFO, "Stream %i (type %i, codec '%s', %i channels) uses the '%s' preset",
+            m_Settings.iStreamID, m_iStreamType, m_strCodecId.c_str(), m_iChannels, m_Preset.strName);
+
+  /* the modes are checked by their descriptors, an instance is created
+   * only for the mode selected with MasterProcessSetMode */
+  {
+    CLockObject lock(g_DSPProcessor.m_Mutex);
+    for (masterModesMap::iterator it = g_DSPProcessor.m_MasterModesMap.begin(); it != g_DSPProcessor.m_MasterModesMap.end(); it++)
     {
-      CDSPProcessMaster *mode;
-      if (m_Settings.iStreamID == 0)
-        mode = it->second;
-      else
-      {
-        mode = CDSPProcessMaster::AllocateMaster(m_Settings.iStreamID, it->second->GetId());
-        mode->m_ModeInfoStruct.iUniqueDBModeId = it->second->m_ModeInfoStruct.iUniqueDBModeId; //!< Is set on first load registration of mode and is not set on load further loads
-      }
-      m_MasterModes.push_back(mode);
+      const sDSPMasterModeDescriptor *descriptor = CDSPMasterModeRegistry::Find(it->first);
+      if (descriptor && CDSPMasterModeRegistry::IsSupported(descriptor, settings, pProperties))
+        m_MasterModes.push_back(it->first);
     }
   }
 
@@ -148,36 +195,83 @@ AE_DSP_ERROR cDSPProcessorStream::StreamCreate(const AE_DSP_SETTINGS *settings,
 
 AE_DSP_ERROR cDSPProcessorStream::StreamDestroy()
 {
-  if (m_MasterCurrrentMode)
-    m_MasterCurrrentMode->Deinitialize();
-  m_MasterCurrrentMode = NULL;
-  for (unsigned int i = 0; i < m_MasterModes.size(); ++i)
   {
-    if (m_MasterModes[i]->GetStreamId() > 0)
-      delete m_MasterModes[i];
+    CLockObject lock(m_MasterMutex);
+
+    delete m_MasterPipeline;
+    m_MasterPipeline = NULL;
+
+    if (m_MasterCurrrentMode)
+    {
+      m_MasterCurrrentMode->Deinitialize();
+      delete m_MasterCurrrentMode;
+    }
+    m_MasterCurrrentMode = NULL;
   }
   m_MasterModes.clear();
 
   if (m_SoundTest)
     delete m_SoundTest;
+  m_SoundTest = NULL;
+
+  Reset();
 
   return AE_DSP_ERROR_NO_ERROR;
 }
 
+void cDSPProcessorStream::Reset()
+{
+  CLockObject lock(g_DSPProcessor.m_Mutex);
+
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    if (m_Delay[i] != NULL)
+      m_Delay[i]->Flush();
+    for (int profile = 0; profile < SPEAKER_PROFILES; ++profile)
+    {
+      if (m_AllPass[profile][i] != NULL)
+        m_AllPass[profile][i]->Flush();
+    }
+  }
+
+  if (m_Compressor)
+    m_Compressor->Flush();
+  if (m_LoudnessMeter)
+    m_LoudnessMeter->Reset();
+  m_LoudnessGainDB      = 0.0f;
+
+  m_MasterTailLeft      = 0;
+  m_CompressorTailLeft  = 0;
+  m_DialogueTailLeft    = 0;
+
+  m_Routing.iInCount    = 0;
+  m_Routing.iOutCount   = 0;
+
+  m_Preset = CDSPStreamPresetResolver::GetDefault();
+}
+
 AE_DSP_ERROR cDSPProcessorStream::StreamIsModeSupported(AE_DSP_MODE_TYPE mode_type, unsigned int mode_id, int unique_db_mode_id)
 {
   (void) unique_db_mode_id;
 
-  for (unsigned int i = 0; i < m_MasterModes.size(); ++i)
+  if (mode_type == AE_DSP_MODE_TYPE_MASTER_PROCESS)
   {
-    if (m_MasterModes[i]->m_ModeInfoStruct.iModeType == mode_type &&
-        m_MasterModes[i]->m_ModeInfoStruct.iModeNumber == mode_id)
-    return AE_DSP_ERROR_NO_ERROR;
+    for (unsigned int i = 0; i < m_MasterModes.size(); ++i)
+    {
+      if (m_MasterModes[i] == mode_id)
+        return AE_DSP_ERROR_NO_ERROR;
+    }
   }
 
-  if (mode_type == AE_DSP_MODE_TYPE_POST_PROCESS)
+  if (mode_type == AE_DSP_MODE_TYPE_PRE_PROCESS)
+  {
+    if (mode_id == ID_PRE_PROCESS_LOUDNESS_NORMALIZATION)
+      return AE_DSP_ERROR_NO_ERROR;
+  }
+  else if (mode_type == AE_DSP_MODE_TYPE_POST_PROCESS)
   {
-    if (mode_id == ID_POST_PROCESS_SPEAKER_CORRECTION)
+    if (mode_id == ID_POST_PROCESS_SPEAKER_CORRECTION ||
+        mode_id == ID_POST_PROCESS_DIALOGUE_ENHANCEMENT)
       return AE_DSP_ERROR_NO_ERROR;
   }
 
@@ -202,91 +296,81 @@ AE_DSP_ERROR cDSPProcessorStream::StreamInitialize(const AE_DSP_SETTINGS *settin
   m_Settings.iOutSamplerate         = settings->iOutSamplerate;
   m_Settings.bStereoUpmix           = settings->bStereoUpmix;
 
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_FL)
-  {
-    UpdateDelay(AE_DSP_CH_FL);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_FR)
-  {
-    UpdateDelay(AE_DSP_CH_FR);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_FC)
-  {
-    UpdateDelay(AE_DSP_CH_FC);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_LFE)
-  {
-    UpdateDelay(AE_DSP_CH_LFE);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_BL)
-  {
-    UpdateDelay(AE_DSP_CH_BL);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_BR)
-  {
-    UpdateDelay(AE_DSP_CH_BR);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_FLOC)
-  {
-    UpdateDelay(AE_DSP_CH_FLOC);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_FROC)
-  {
-    UpdateDelay(AE_DSP_CH_FROC);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_BC)
-  {
-    UpdateDelay(AE_DSP_CH_BC);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_SL)
-  {
-    UpdateDelay(AE_DSP_CH_SL);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_SR)
-  {
-    UpdateDelay(AE_DSP_CH_SR);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TFL)
-  {
-    UpdateDelay(AE_DSP_CH_TFL);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TFR)
-  {
-    UpdateDelay(AE_DSP_CH_TFR);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TFC)
-  {
-    UpdateDelay(AE_DSP_CH_TFC);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TC)
-  {
-    UpdateDelay(AE_DSP_CH_TC);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TBL)
-  {
-    UpdateDelay(AE_DSP_CH_TBL);
-  }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TBR)
+  m_Routing.iInCount  = 0;
+  m_Routing.iOutCount = 0;
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
   {
-    UpdateDelay(AE_DSP_CH_TBR);
+    if (m_Settings.lInChannelPresentFlags & (1 << i))
+      m_Routing.iIn[m_Routing.iInCount++] = (AE_DSP_CHANNEL)i;
+    if (m_Settings.lOutChannelPresentFlags & (1 << i))
+      m_Routing.iOut[m_Routing.iOutCount++] = (AE_DSP_CHANNEL)i;
   }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TBC)
+
+  m_Profile = g_DSPProcessor.m_SpeakerProfile;
+  PrepareProfiles();
+
+  /* the layout or rate can differ from the last initialize, and a pooled
+   * stream keeps the stages of its last use */
+  if (m_Compressor)
+    m_Compressor->Init(m_Settings.lOutChannelPresentFlags, m_Settings.iProcessSamplerate, m_Settings.iProcessFrames);
+  if (m_Dialogue)
+    m_Dialogue->Init(m_Settings.lOutChannelPresentFlags, m_Settings.iProcessSamplerate, m_Settings.iProcessFrames);
+
+  UpdateCompressor();
+  UpdateLoudness();
+  UpdateDialogue();
+
+  UpdatePostProcessKernel();
+
+  /* the worker must not run while the mode is initialized */
   {
-    UpdateDelay(AE_DSP_CH_TBC);
+    CLockObject lock(m_MasterMutex);
+
+    delete m_MasterPipeline;
+    m_MasterPipeline = NULL;
+
+    if (m_MasterCurrrentMode)
+      err = m_MasterCurrrentMode->Initialize(&m_Settings);
   }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_BLOC)
+
+  UpdateMasterPipeline();
+
+  return err;
+}
+
+void cDSPProcessorStream::UpdateMasterPipeline()
+{
+  const sDSPMasterModeDescriptor *descriptor = m_MasterCurrrentMode ? CDSPMasterModeRegistry::Find(m_MasterCurrrentMode->GetId()) : NULL;
+  bool pipelined = g_DSPProcessor.m_MasterPipelining &&
+                   descriptor && descriptor->iCost >= MASTER_MODE_COST_HEAVY;
+
+  if (pipelined && m_MasterPipeline && m_MasterPipeline->GetMode() == m_MasterCurrrentMode)
+    return;
+  if (!pipelined && !m_MasterPipeline)
+    return;
+
+  /* the worker is started before it is published to MasterProcess */
+  CDSPMasterPipeline *pipeline = NULL;
+  if (pipelined)
   {
-    UpdateDelay(AE_DSP_CH_BLOC);
+    pipeline = new CDSPMasterPipeline(m_MasterCurrrentMode);
+    if (pipeline->Initialize(&m_Settings))
+      KODI->Log(LOG_INFO, "Master mode '%s' runs on a worker thread with %.1f ms extra latency", m_MasterCurrrentMode->GetName(), pipeline->GetDelay() * 1000.0f);
+    else
+    {
+      KODI->Log(LOG_ERROR, "Failed to start worker thread of master mode '%s', processing it inline", m_MasterCurrrentMode->GetName());
+      delete pipeline;
+      pipeline = NULL;
+    }
   }
-  if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_BROC)
+
+  CDSPMasterPipeline *previous;
   {
-    UpdateDelay(AE_DSP_CH_BROC);
+    CLockObject lock(m_MasterMutex);
+    previous          = m_MasterPipeline;
+    m_MasterPipeline  = pipeline;
   }
-
-  if (m_MasterCurrrentMode)
-    err = m_MasterCurrrentMode->Initialize(&m_Settings);
-
-  return err;
+  delete previous;
 }
 
 
@@ -296,6 +380,11 @@ AE_DSP_ERROR cDSPProcessorStream::StreamInitialize(const AE_DSP_SETTINGS *settin
 
 bool cDSPProcessorStream::InputProcess(const float **array_in, unsigned int samples)
 {
+  CLockObject lock(g_DSPProcessor.m_Mutex);
+
+  /* Measure here, every input block passes once and no buffering is needed */
+  if (m_LoudnessMeter)
+    m_LoudnessMeter->Process(array_in, samples);
   return true;
 }
 
@@ -342,7 +431,51 @@ float cDSPProcessorStream::PreProcessGetDelay()
 
 unsigned int cDSPProcessorStream::PreProcess(float **array_in, float **array_out, unsigned int samples)
 {
-  return CopyInToOut(array_in, array_out, samples);
+  CLockObject lock(g_DSPProcessor.m_Mutex);
+
+  if (!m_LoudnessMeter || samples == 0)
+    return CopyInToOut(array_in, array_out, samples);
+
+  /* Loudness normalization, gain is smoothed with a slow one pole in dB per block */
+  float gainDB    = m_LoudnessGainDB;
+  float loudness  = m_LoudnessMeter->GetIntegratedLoudness();
+  if (loudness > LOUDNESS_UNKNOWN)
+  {
+    float target = g_DSPProcessor.m_LoudnessTarget - loudness;
+    if (target > LOUDNESS_GAIN_DB_MAX)
+      target = LOUDNESS_GAIN_DB_MAX;
+    else if (target < LOUDNESS_GAIN_DB_MIN)
+      target = LOUDNESS_GAIN_DB_MIN;
+
+    float coeff = expf(-(float)samples / (LOUDNESS_GAIN_SMOOTH_TIME * m_Settings.iProcessSamplerate));
+    gainDB = target + coeff * (m_LoudnessGainDB - target);
+  }
+
+  /* settled at 0 dB, nothing to apply */
+  if (fabsf(gainDB) < LOUDNESS_GAIN_DB_UNITY && fabsf(m_LoudnessGainDB) < LOUDNESS_GAIN_DB_UNITY)
+  {
+    m_LoudnessGainDB = gainDB;
+    return CopyInToOut(array_in, array_out, samples);
+  }
+
+  float gain  = DB_CO(m_LoudnessGainDB);
+  float step  = (DB_CO(gainDB) - gain) / samples;
+  for (unsigned int i = 0; i < m_Routing.iInCount; ++i)
+  {
+    const float *in = array_in[m_Routing.iIn[i]];
+    float *out      = array_out[m_Routing.iIn[i]];
+    if (IsSilent(in, samples))
+    {
+      if (out != in)
+        memset(out, 0, samples * sizeof(float));
+      continue;
+    }
+    for (unsigned int pos = 0; pos < samples; ++pos)
+      out[pos] = in[pos] * (gain + step * pos);
+  }
+  m_LoudnessGainDB = gainDB;
+
+  return samples;
 }
 
 /*!
@@ -352,27 +485,63 @@ unsigned int cDSPProcessorStream::PreProcess(float **array_in, float **array_out
 
 AE_DSP_ERROR cDSPProcessorStream::MasterProcessSetMode(AE_DSP_STREAMTYPE type, unsigned int mode_id, int unique_db_mode_id)
 {
+  if (m_MasterCurrrentMode && m_MasterCurrrentMode->GetId() == mode_id)
+    return AE_DSP_ERROR_NO_ERROR;
+
+  const sDSPMasterModeDescriptor *descriptor = NULL;
   for (unsigned int i = 0; i < m_MasterModes.size(); ++i)
   {
-    if (m_MasterModes[i] != NULL && m_MasterModes[i]->GetId() == mode_id)
+    if (m_MasterModes[i] == mode_id)
     {
-      m_MasterCurrrentMode = m_MasterModes[i];
+      descriptor = CDSPMasterModeRegistry::Find(mode_id);
       break;
     }
   }
 
-  if (m_MasterCurrrentMode == NULL)
+  CDSPProcessMaster *mode = descriptor ? descriptor->Create(m_Settings.iStreamID) : NULL;
+  if (mode == NULL)
   {
     KODI->Log(LOG_ERROR, "Requested client id '%i' not present on current processor", mode_id);
     return AE_DSP_ERROR_UNKNOWN;
   }
+  AE_DSP_ERROR err = mode->Initialize(&m_Settings);
+  if (err != AE_DSP_ERROR_NO_ERROR)
+  {
+    /* the mode in use stays active */
+    KODI->Log(LOG_ERROR, "Failed to initialize master mode '%s' with id '%i'", mode->GetName(), mode_id);
+    delete mode;
+    return err;
+  }
+
+  /* MasterProcess can run on the audio thread meanwhile, the new mode is
+   * ready before it is swapped in and the old one is freed after the swap */
+  CDSPProcessMaster  *previous;
+  CDSPMasterPipeline *previousPipeline;
+  {
+    CLockObject lock(m_MasterMutex);
+    previous              = m_MasterCurrrentMode;
+    previousPipeline      = m_MasterPipeline;
+    m_MasterCurrrentMode  = mode;
+    m_MasterPipeline      = NULL;
+  }
+
+  /* the worker of the old pipeline still uses the old mode until it is stopped */
+  delete previousPipeline;
+  if (previous)
+  {
+    previous->Deinitialize();
+    delete previous;
+  }
 
   KODI->Log(LOG_INFO, "Master processing set mode to '%s' with id '%i'", m_MasterCurrrentMode->GetName(), mode_id);
+  UpdateMasterPipeline();
   return AE_DSP_ERROR_NO_ERROR;
 }
 
 unsigned int cDSPProcessorStream::MasterProcessNeededSamplesize()
 {
+  CLockObject lock(m_MasterMutex);
+
   if (!m_MasterCurrrentMode)
     return 0;
   return m_MasterCurrrentMode->GetNeededSamplesize();
@@ -380,32 +549,65 @@ unsigned int cDSPProcessorStream::MasterProcessNeededSamplesize()
 
 float cDSPProcessorStream::MasterProcessGetDelay()
 {
+  CLockObject lock(m_MasterMutex);
+
   if (!m_MasterCurrrentMode)
     return 0.0;
+  if (m_MasterPipeline)
+    return m_MasterCurrrentMode->GetDelay() + m_MasterPipeline->GetDelay();
   return m_MasterCurrrentMode->GetDelay();
 }
 
 unsigned int cDSPProcessorStream::MasterProcess(float **array_in, float **array_out, unsigned int samples)
 {
+  /* only contended while MasterProcessSetMode swaps the mode */
+  CLockObject lock(m_MasterMutex);
+
   if (!m_MasterCurrrentMode)
     return CopyInToOut(array_in, array_out, samples);
+
+  /* on silent input the mode is bypassed once its tail is out */
+  int tailLength = m_MasterCurrrentMode->GetTailLength();
+  if (tailLength >= 0)
+  {
+    bool silent = true;
+    for (unsigned int i = 0; i < m_Routing.iInCount && silent; ++i)
+      silent = IsSilent(array_in[m_Routing.iIn[i]], samples);
+
+    if (m_MasterPipeline)
+      tailLength += m_MasterPipeline->GetLatency();
+    if (UpdateTail(silent, m_MasterTailLeft, tailLength, samples))
+    {
+      for (unsigned int i = 0; i < m_Routing.iOutCount; ++i)
+        memset(array_out[m_Routing.iOut[i]], 0, samples * sizeof(float));
+      return samples;
+    }
+  }
+
+  if (m_MasterPipeline)
+    return m_MasterPipeline->ProcessBlock(array_in, array_out, samples);
   return m_MasterCurrrentMode->Process(array_in, array_out, samples);
 }
 
 unsigned int cDSPProcessorStream::CopyInToOut(float **array_in, float **array_out, unsigned int samples)
 {
-  int presentFlag = 1;
-  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  /* stages called in place have nothing to copy */
+  if (array_in == array_out)
+    return samples;
+
+  for (unsigned int i = 0; i < m_Routing.iOutCount; ++i)
   {
-    if (m_Settings.lOutChannelPresentFlags & presentFlag)
-      memcpy(array_out[i], array_in[i], samples*sizeof(float));
-    presentFlag <<= 1;
+    AE_DSP_CHANNEL channel = m_Routing.iOut[i];
+    if (array_out[channel] != array_in[channel])
+      memcpy(array_out[channel], array_in[channel], samples*sizeof(float));
   }
   return samples;
 }
 
 int cDSPProcessorStream::MasterProcessGetOutChannels(unsigned long &out_channel_present_flags)
 {
+  CLockObject lock(m_MasterMutex);
+
   if (!m_MasterCurrrentMode)
     return -1;
   return m_MasterCurrrentMode->MasterProcessGetOutChannels(out_channel_present_flags);
@@ -413,6 +615,8 @@ int cDSPProcessorStream::MasterProcessGetOutChannels(unsigned long &out_channel_
 
 const char *cDSPProcessorStream::MasterProcessGetStreamInfoString()
 {
+  CLockObject lock(m_MasterMutex);
+
   static std::string strStreamInfoString;
   if (m_MasterCurrrentMode)
     strStreamInfoString = m_MasterCurrrentMode->GetStreamInfoString();
@@ -438,22 +642,82 @@ float cDSPProcessorStream::PostProcessGetDelay(unsigned int modeId)
 
   float delay = 0.0;
 
-  if (g_DSPProcessor.m_SpeakerDelayMax > 0)
+  /* dialogue enhancement works sample aligned */
+  if (modeId != ID_POST_PROCESS_SPEAKER_CORRECTION)
+    return delay;
+
+  if (m_Settings.iProcessSamplerate == 0)
+    return delay;
+
+  /* the stages and the delay line of every channel, the channels only
+   * differ by the speaker correction */
+  unsigned int latency = 0;
+  for (unsigned int i = 0; i < m_Routing.iOutCount; ++i)
   {
-    delay += (float)(g_DSPProcessor.m_SpeakerDelayMax) / DELAY_RESOLUTION;
+    unsigned int channelLatency = m_Latency.GetChannelLatency(m_Routing.iOut[i]);
+    if (m_Routing.pDelay[i])
+      channelLatency += m_Routing.pDelay[i]->GetLatency();
+    if (channelLatency > latency)
+      latency = channelLatency;
   }
 
+  delay = (float)latency / m_Settings.iProcessSamplerate;
+
   return delay;
 }
 
-void cDSPProcessorStream::PostProcessChannelSample(AE_DSP_CHANNEL channel, float **array_out, int pos)
+/*!
+ * LIMITED is set while the compressor stage runs, it controls the level after
+ * the delay and the clamp is left out. The kernel is instantiated for both
+ * cases, so the sample loop has no branch on it.
+ */
+template <bool LIMITED>
+inline void cDSPProcessorStream::PostProcessChannel(unsigned int index, float *data, unsigned int samples)
 {
-  array_out[channel][pos] = SoftClamp(g_DSPProcessor.m_OutputGain[channel] * array_out[channel][pos]);
-  if (m_Delay[channel] != NULL)
+  bool idle = UpdateTail(IsSilent(data, samples), m_Routing.iTailLeft[index], m_Routing.iTailLength[index], samples);
+  m_Routing.bIdle[index] = idle;
+  if (idle)
+  {
+    memset(data, 0, samples * sizeof(float));
+    return;
+  }
+
+  float gain        = m_Routing.fGain[index];
+  Cfilter *allPass  = m_Routing.pAllPass[index];
+  CDelay *delay     = m_Routing.pDelay[index];
+
+  if (allPass != NULL)
   {
-    m_Delay[channel]->Store(array_out[channel][pos]);
-    array_out[channel][pos] = m_Delay[channel]->Retrieve();
+    for (unsigned int pos = 0; pos < samples; ++pos)
+      data[pos] = (float)allPass->GetNext(data[pos]);
   }
+
+  for (unsigned int pos = 0; pos < samples; ++pos)
+    data[pos] = LIMITED ? gain * data[pos] : SoftClamp(gain * data[pos]);
+
+  if (delay != NULL)
+  {
+    for (unsigned int pos = 0; pos < samples; ++pos)
+    {
+      delay->Store(data[pos]);
+      data[pos] = (float)delay->Retrieve();
+    }
+  }
+}
+
+template <bool LIMITED>
+void cDSPProcessorStream::PostProcessChannels(float **array_out, unsigned int samples)
+{
+  for (unsigned int i = 0; i < m_Routing.iOutCount; ++i)
+    PostProcessChannel<LIMITED>(i, array_out[m_Routing.iOut[i]], samples);
+}
+
+void cDSPProcessorStream::UpdatePostProcessKernel()
+{
+  if (m_Compressor)
+    m_PostProcessKernel = &cDSPProcessorStream::PostProcessChannels<true>;
+  else
+    m_PostProcessKernel = &cDSPProcessorStream::PostProcessChannels<false>;
 }
 
 unsigned int cDSPProcessorStream::PostProcess(unsigned int modeId, float **array_in, float **array_out, unsigned int samples)
@@ -465,179 +729,427 @@ unsigned int cDSPProcessorStream::PostProcess(unsigned int modeId, float **array
    */
   if (modeId == ID_POST_PROCESS_SPEAKER_CORRECTION)
   {
+    CLockObject lock(g_DSPProcessor.m_Mutex);
+
+    /* nothing to correct, without a compressor stage the clamp still
+     * bends the peaks */
+    if (!m_SoundTest && !m_Compressor && m_Routing.bUnity)
+    {
+      samples = CopyInToOut(array_in, array_out, samples);
+      for (unsigned int i = 0; i < m_Routing.iOutCount; ++i)
+      {
+        float *data = array_out[m_Routing.iOut[i]];
+        for (unsigned int pos = 0; pos < samples; ++pos)
+          data[pos] = SoftClamp(data[pos]);
+      }
+      return samples;
+    }
+
+    /* test signals pass the correction below, as the speakers get it on playback.
+     * Only the calibration sweep measures the speakers without it. */
+    bool soundTest = m_SoundTest && m_SoundTest->GetTestMode() != SOUND_TEST_OFF;
     if (m_SoundTest)
-      return m_SoundTest->ProcessTestMode(array_in, array_out, samples);
+    {
+      samples = m_SoundTest->ProcessTestMode(array_in, array_out, samples);
+      if (m_SoundTest->GetTestMode() == SOUND_TEST_SWEEP)
+        return samples;
+    }
     else
       samples = CopyInToOut(array_in, array_out, samples);
 
+    (this->*m_PostProcessKernel)(array_out, samples);
+
+    if (m_Compressor && !soundTest)
+    {
+      bool idle = true;
+      for (unsigned int i = 0; i < m_Routing.iOutCount && idle; ++i)
+        idle = m_Routing.bIdle[i];
+
+      if (!UpdateTail(idle, m_CompressorTailLeft, m_Compressor->GetTailLength(), samples))
+        m_Compressor->Process(array_out, samples);
+    }
+  }
+  else if (modeId == ID_POST_PROCESS_DIALOGUE_ENHANCEMENT)
+  {
+    samples = CopyInToOut(array_in, array_out, samples);
+
     CLockObject lock(g_DSPProcessor.m_Mutex);
 
-    for (unsigned int pos = 0; pos < samples; pos++)
-    {
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_FL)
-        PostProcessChannelSample(AE_DSP_CH_FL,   array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_FR)
-        PostProcessChannelSample(AE_DSP_CH_FR,   array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_FC)
-        PostProcessChannelSample(AE_DSP_CH_FC,   array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_LFE)
-        PostProcessChannelSample(AE_DSP_CH_LFE,  array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_BL)
-        PostProcessChannelSample(AE_DSP_CH_BL,   array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_BR)
-        PostProcessChannelSample(AE_DSP_CH_BR,   array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_FLOC)
-        PostProcessChannelSample(AE_DSP_CH_FLOC, array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_FROC)
-        PostProcessChannelSample(AE_DSP_CH_FROC, array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_BC)
-        PostProcessChannelSample(AE_DSP_CH_BC,   array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_SL)
-        PostProcessChannelSample(AE_DSP_CH_SL,   array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_SR)
-        PostProcessChannelSample(AE_DSP_CH_SR,   array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TFL)
-        PostProcessChannelSample(AE_DSP_CH_TFL,  array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TFR)
-        PostProcessChannelSample(AE_DSP_CH_TFR,  array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TFC)
-        PostProcessChannelSample(AE_DSP_CH_TFC,  array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TC)
-        PostProcessChannelSample(AE_DSP_CH_TC,   array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TBL)
-        PostProcessChannelSample(AE_DSP_CH_TBL,  array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TBR)
-        PostProcessChannelSample(AE_DSP_CH_TBR,  array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_TBC)
-        PostProcessChannelSample(AE_DSP_CH_TBC,  array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_BLOC)
-        PostProcessChannelSample(AE_DSP_CH_BLOC, array_out, pos);
-      if (m_Settings.lOutChannelPresentFlags & AE_DSP_PRSNT_CH_BROC)
-        PostProcessChannelSample(AE_DSP_CH_BROC, array_out, pos);
+    if (m_Dialogue && !m_Dialogue->IsUnity())
+    {
+      bool silent = true;
+      for (unsigned int i = 0; i < m_Routing.iOutCount && silent; ++i)
+        silent = IsSilent(array_out[m_Routing.iOut[i]], samples);
+
+      unsigned int tailLength = (unsigned int)(SILENCE_DIALOGUE_TAIL * m_Settings.iProcessSamplerate);
+      if (!UpdateTail(silent, m_DialogueTailLeft, tailLength, samples))
+        m_Dialogue->Process(array_out, samples);
     }
   }
   return samples;
 }
 
-inline float cDSPProcessorStream::SoftClamp(float x)
-{
-#if 0
-  /*
-     This is a rational function to approximate a tanh-like soft clipper.
-     It is based on the pade-approximation of the tanh function with tweaked coefficients.
-     See: http://www.musicdsp.org/showone.php?id=238
-  */
-  if (x < -3.0f)
-    return -1.0f;
-  else if (x >  3.0f)
-    return 1.0f;
-  float y = x * x;
-  return x * (27.0f + y) / (27.0f + 9.0f * y);
-#else
-  /* slower method using tanh, but more accurate */
-
-  static const double k = 0.9f;
-  /* perform a soft clamp */
-  if (x >  k)
-    x = (float)(tanh((x - k) / (1 - k)) * (1 - k) + k);
-  else if (x < -k)
-    x = (float)(tanh((x + k) / (1 - k)) * (1 - k) - k);
-
-  /* hard clamp anything still outside the bounds */
-  if (x >  1.0f)
-    return  1.0f;
-  if (x < -1.0f)
-    return -1.0f;
-
-  /* return the final sample */
-  return x;
-#endif
+bool cDSPProcessorStream::IsSilent(const float *data, unsigned int samples)
+{
+  for (unsigned int pos = 0; pos < samples; ++pos)
+  {
+    if (fabsf(data[pos]) > SILENCE_LEVEL)
+      return false;
+  }
+  return true;
+}
+
+/*!
+ * Counts down the tail of a stage while the input is silent, returns true
+ * once the stage is flushed and can be bypassed
+ */
+bool cDSPProcessorStream::UpdateTail(bool silent, unsigned int &tailLeft, unsigned int tailLength, unsigned int samples)
+{
+  if (!silent)
+  {
+    tailLeft = tailLength;
+    return false;
+  }
+  if (tailLeft == 0)
+    return true;
+
+  tailLeft = tailLeft > samples ? tailLeft - samples : 0;
+  return false;
 }
 
 void cDSPProcessorStream::UpdateDelay(AE_DSP_CHANNEL channel)
 {
-  if (g_DSPProcessor.m_SpeakerDelay[channel] > 0)
+  /* one line per channel serves all profiles. Its ring holds the longest
+   * delay of them, so a profile switch only moves the read position and the
+   * audio in the line keeps playing */
+  unsigned int longest = 0;
+  for (int profile = 0; profile < SPEAKER_PROFILES; ++profile)
   {
-    if (m_Delay[channel] == NULL)
-      m_Delay[channel] = new CDelay;
+    if (g_DSPProcessor.m_SpeakerDelay[profile][channel] > longest)
+      longest = g_DSPProcessor.m_SpeakerDelay[profile][channel];
+  }
 
-    m_Delay[channel]->Init(g_DSPProcessor.m_SpeakerDelay[channel], m_Settings.iProcessSamplerate);
+  CDelay *&delay = m_Delay[channel];
+  unsigned int active  = g_DSPProcessor.m_SpeakerDelay[m_Profile][channel];
+  unsigned int padding = m_Latency.GetPadding(channel, m_Settings.lOutChannelPresentFlags);
+  if (longest > 0 || padding > 0)
+  {
+    /* cDSPProcessor::SetDelay has a longer ring ready, otherwise the line
+     * grows here under the processor lock */
+    if (delay == NULL)
+    {
+      delay = new CDelay;
+      delay->Init(active, m_Settings.iProcessSamplerate);
+    }
+    else if (delay->GetSamplingRate() != m_Settings.iProcessSamplerate)
+      delay->Init(active, m_Settings.iProcessSamplerate);
+    else
+      delay->SetDelay(active);
+    delay->SetPadding(padding);
+    delay->Reserve(longest);
   }
-  else if (m_Delay[channel] != NULL)
+  else if (delay != NULL)
   {
-    delete m_Delay[channel];
-    m_Delay[channel] = NULL;
+    delete delay;
+    delay = NULL;
   }
+
+  for (int profile = 0; profile < SPEAKER_PROFILES; ++profile)
+    UpdateRouting(profile);
 }
 
-void cDSPProcessorStream::SetTestSound(AE_DSP_CHANNEL channel, int mode, CGUIDialogSpeakerGain *cbClass, bool continues)
+void cDSPProcessorStream::UpdateAllPass(AE_DSP_CHANNEL channel, int profile)
 {
-  CLockObject lock(g_DSPProcessor.m_Mutex);
-
-  if (mode != SOUND_TEST_OFF)
+  Cfilter *&allPass = m_AllPass[profile][channel];
+  int frequency = g_DSPProcessor.m_AllPassFrequency[profile][channel];
+  if (frequency > 0 && (unsigned int)frequency * 2 < m_Settings.iProcessSamplerate)
   {
-    if (!m_SoundTest)
-      m_SoundTest = new cDSPProcessorSoundTest(m_Settings.lOutChannelPresentFlags, cbClass);
-    m_SoundTest->SetTestMode(mode, channel, continues);
+    int numzero;
+    int numpole;
+    double xcoeffs[MAXPZ+1];
+    double ycoeffs[MAXPZ+1];
+    double gain;
+
+    /* Second order allpass resonator, phase turns by 180 degrees at the given frequency */
+    if (mkfilter(RESONATOR, ALL_PASS, 2, (double)frequency / m_Settings.iProcessSamplerate, 0.0, 0.0,
+                 &numzero, xcoeffs, &numpole, ycoeffs, &gain,
+                 (double)g_DSPProcessor.m_AllPassQ[profile][channel] / ALLPASS_Q_SCALE) && gain > 0.0)
+    {
+      if (allPass == NULL)
+        allPass = new Cfilter;
+      allPass->Config(numzero, xcoeffs, numpole, ycoeffs, gain);
+      UpdateRouting(profile);
+      return;
+    }
+    KODI->Log(LOG_ERROR, "%s - all-pass design failed for channel %i at %i Hz, filter disabled", __FUNCTION__, channel, frequency);
   }
-  else
+
+  if (allPass != NULL)
   {
-    if (m_SoundTest)
-      delete m_SoundTest;
-    m_SoundTest = NULL;
+    delete allPass;
+    allPass = NULL;
   }
+  UpdateRouting(profile);
 }
 
-AE_DSP_SETTINGS *cDSPProcessorStream::GetStreamSettings()
+void cDSPProcessorStream::UpdateRouting(int profile)
 {
-  return &m_Settings;
-}
+  sProfileRouting &routing = m_ProfileRouting[profile];
 
+  routing.bUnity = true;
+  for (unsigned int i = 0; i < m_Routing.iOutCount; ++i)
+  {
+    AE_DSP_CHANNEL channel = m_Routing.iOut[i];
+    routing.fGain[i]    = g_DSPProcessor.m_OutputGain[profile][channel] * g_DSPProcessor.m_OutputPolarity[profile][channel];
+    routing.pAllPass[i] = m_AllPass[profile][channel];
+    routing.pDelay[i]   = m_Delay[channel];
+
+    /* ring out of the resonator down by SILENCE_DECAY time constants, plus the delay line */
+    unsigned int tail = 0;
+    if (routing.pAllPass[i])
+    {
+      float q = (float)g_DSPProcessor.m_AllPassQ[profile][channel] / ALLPASS_Q_SCALE;
+      tail = (unsigned int)(SILENCE_DECAY * q * m_Settings.iProcessSamplerate / ((float)M_PI * g_DSPProcessor.m_AllPassFrequency[profile][channel]));
+    }
+    if (routing.pDelay[i])
+      tail += (unsigned int)(double(g_DSPProcessor.m_SpeakerDelay[profile][channel])/DELAY_RESOLUTION*m_Settings.iProcessSamplerate) + routing.pDelay[i]->GetPadding();
+    routing.iTailLength[i] = tail;
 
-/*!
- * Resampling related functions after final processing.
- * only one dsp addon is allowed to do this
- */
+    if (routing.fGain[i] != 1.0f || routing.pAllPass[i] || routing.pDelay[i])
+      routing.bUnity = false;
+  }
 
-unsigned int cDSPProcessorStream::OutputResampleProcessNeededSamplesize()
-{
-  return 0;
+  if (profile == m_Profile)
+    ActivateProfile(profile);
 }
 
-int cDSPProcessorStream::OutputResampleSampleRate()
+void cDSPProcessorStream::SetSpeakerProfile(int profile)
 {
-  return m_Settings.iInSamplerate;
+  if (profile == m_Profile)
+    return;
+
+  /* called under the processor lock, the post process continues with the
+   * new profile on the next block. Nothing is allocated or designed, the
+   * delay lines move their read position and keep the audio in them */
+  m_Profile = profile;
+  for (unsigned int i = 0; i < m_Routing.iOutCount; ++i)
+  {
+    AE_DSP_CHANNEL channel = m_Routing.iOut[i];
+    if (m_Delay[channel])
+      m_Delay[channel]->SetDelay(g_DSPProcessor.m_SpeakerDelay[profile][channel]);
+    if (m_AllPass[profile][channel])
+      m_AllPass[profile][channel]->Flush();
+  }
+  ActivateProfile(profile);
 }
 
-float cDSPProcessorStream::OutputResampleGetDelay()
+void cDSPProcessorStream::PrepareProfiles()
 {
-  return 0.0;
+  /* every profile gets its filters and routing, a pooled stream can still
+   * hold the stages of channels its last layout had */
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    if (m_Settings.lOutChannelPresentFlags & (1 << i))
+    {
+      UpdateDelay((AE_DSP_CHANNEL)i);
+      for (int profile = 0; profile < SPEAKER_PROFILES; ++profile)
+        UpdateAllPass((AE_DSP_CHANNEL)i, profile);
+    }
+    else
+    {
+      SAFE_DELETE(m_Delay[i]);
+      for (int profile = 0; profile < SPEAKER_PROFILES; ++profile)
+        SAFE_DELETE(m_AllPass[profile][i]);
+    }
+  }
+  for (int profile = 0; profile < SPEAKER_PROFILES; ++profile)
+    UpdateRouting(profile);
 }
 
-unsigned int cDSPProcessorStream::OutputResampleProcess(float **array_in, float **array_out, unsigned int samples)
+void cDSPProcessorStream::ActivateProfile(int profile)
 {
-  return CopyInToOut(array_in, array_out, samples);
-}
+  /* runs under the processor lock like the post process, a block never sees a mix of two profiles */
+  const sProfileRouting &routing = m_ProfileRouting[profile];
 
+  m_Routing.bUnity = routing.bUnity;
+  for (unsigned int i = 0; i < m_Routing.iOutCount; ++i)
+  {
+    m_Routing.fGain[i]        = routing.fGain[i];
+    m_Routing.pAllPass[i]     = routing.pAllPass[i];
+    m_Routing.pDelay[i]       = routing.pDelay[i];
+    m_Routing.iTailLength[i]  = routing.iTailLength[i];
+    m_Routing.iTailLeft[i]    = routing.iTailLength[i];
+  }
+}
 
-/*!
- * Processing functions
- */
+void cDSPProcessorStream::UpdateCompressor()
+{
+  int mode = CDSPStreamPresetResolver::Apply(m_Preset.iDynamicRange, g_DSPProcessor.m_DynamicRange, DYNAMIC_RANGE_DEFAULT);
+  if (mode != DYNAMIC_RANGE_OFF)
+  {
+    sCompressorSettings settings = g_DSPProcessor.m_CompressorSettings;
+    settings.bCompress = mode == DYNAMIC_RANGE_NIGHT_MODE;
+
+    if (m_Compressor == NULL)
+    {
+      m_Compressor = new CCompressor;
+      m_Compressor->SetParameters(settings);
+      m_Compressor->Init(m_Settings.lOutChannelPresentFlags, m_Settings.iProcessSamplerate, m_Settings.iProcessFrames);
+    }
+    else
+      m_Compressor->SetParameters(settings);
+  }
+  else if (m_Compressor != NULL)
+  {
+    delete m_Compressor;
+    m_Compressor = NULL;
+  }
+
+  UpdateLatency();
+  UpdatePostProcessKernel();
+}
+
+void cDSPProcessorStream::UpdateLatency()
+{
+  /* same look-ahead on all channels, this only pads once a stage differs
+   * per channel, see DSPLatencyManager.h */
+  m_Latency.SetStageLatency(LATENCY_STAGE_LIMITER, m_Settings.lOutChannelPresentFlags, m_Compressor ? m_Compressor->GetLatency() : 0);
+
+  /* the padding goes into the speaker delay lines */
+  for (unsigned int i = 0; i < m_Routing.iOutCount; ++i)
+    UpdateDelay(m_Routing.iOut[i]);
+}
+
+void cDSPProcessorStream::UpdateLoudness()
+{
+  bool enable = CDSPStreamPresetResolver::Apply(m_Preset.iLoudness, g_DSPProcessor.m_LoudnessNormalization, LOUDNESS_NORMALIZATION_DEFAULT) != 0;
+  if (enable)
+  {
+    if (m_LoudnessMeter == NULL)
+    {
+      m_LoudnessMeter   = new CLoudnessMeter;
+      m_LoudnessGainDB  = 0.0f;
+    }
+    m_LoudnessMeter->Init(m_Settings.lInChannelPresentFlags, m_Settings.iInSamplerate);
+  }
+  else if (m_LoudnessMeter != NULL)
+  {
+    delete m_LoudnessMeter;
+    m_LoudnessMeter   = NULL;
+    m_LoudnessGainDB  = 0.0f;
+  }
+}
+
+void cDSPProcessorStream::UpdateDialogue()
+{
+  if (g_DSPProcessor.m_DialogueEnhancement)
+  {
+    if (m_Dialogue == NULL)
+    {
+      m_Dialogue = new CDialogueEnhancer;
+      m_Dialogue->Init(m_Settings.lOutChannelPresentFlags, m_Settings.iProcessSamplerate, m_Settings.iProcessFrames);
+    }
+    int boost   = CDSPStreamPresetResolver::Apply(m_Preset.iDialogueBoost, g_DSPProcessor.m_DialogueBoost, DIALOGUE_BOOST_DEFAULT);
+    int ducking = CDSPStreamPresetResolver::Apply(m_Preset.iDialogueDucking, g_DSPProcessor.m_DialogueDucking, DIALOGUE_DUCKING_DEFAULT);
+
+    /* coefficients as in m_OutputGain, the boost is the lift of the speech band */
+    m_Dialogue->SetParameters(GainToScale((float)boost), GainToScale((float)-ducking));
+  }
+  else if (m_Dialogue != NULL)
+  {
+    delete m_Dialogue;
+    m_Dialogue = NULL;
+  }
+}
+
+cDSPProcessorSoundTest *cDSPProcessorStream::SetTestSound(AE_DSP_CHANNEL channel, int mode, CGUIDialogSpeakerGain *cbClass, bool continues)
+{
+  CLockObject lock(g_DSPProcessor.m_Mutex);
+
+  cDSPProcessorSoundTest *released = NULL;
+  if (mode != SOUND_TEST_OFF)
+  {
+    if (!m_SoundTest)
+      m_SoundTest = new cDSPProcessorSoundTest(&m_Routing, m_Settings.lOutChannelPresentFlags, m_Settings.iProcessSamplerate, cbClass);
+    m_SoundTest->SetTestMode(mode, channel, continues);
+  }
+  else
+  {
+    released    = m_SoundTest;
+    m_SoundTest = NULL;
+  }
+  return released;
+}
+
+AE_DSP_SETTINGS *cDSPProcessorStream::GetStreamSettings()
+{
+  return &m_Settings;
+}
+
+
+/*!
+ * Resampling related functions after final processing.
+ * only one dsp addon is allowed to do this
+ */
+
+unsigned int cDSPProcessorStream::OutputResampleProcessNeededSamplesize()
+{
+  return 0;
+}
+
+int cDSPProcessorStream::OutputResampleSampleRate()
+{
+  return m_Settings.iInSamplerate;
+}
+
+float cDSPProcessorStream::OutputResampleGetDelay()
+{
+  return 0.0;
+}
+
+unsigned int cDSPProcessorStream::OutputResampleProcess(float **array_in, float **array_out, unsigned int samples)
+{
+  return CopyInToOut(array_in, array_out, samples);
+}
+
+
+/*!
+ * Processing functions
+ */
 
 cDSPProcessor g_DSPProcessor;
 
 cDSPProcessor::cDSPProcessor() :
-  m_outChannelPresentFlags(0)
+  m_SpeakerProfile(0),
+  m_DynamicRange(DYNAMIC_RANGE_OFF),
+  m_LoudnessNormalization(false),
+  m_LoudnessTarget(LOUDNESS_TARGET_DEFAULT),
+  m_DialogueEnhancement(false),
+  m_DialogueBoost(DIALOGUE_BOOST_DEFAULT),
+  m_DialogueDucking(DIALOGUE_DUCKING_DEFAULT),
+  m_MasterPipelining(false),
+  m_StreamPresets(false),
+  m_outChannelPresentFlags(0),
+  m_Calibration(NULL)
 {
+  memset(m_StreamPool, 0, sizeof(m_StreamPool));
+
+  m_CompressorSettings.bCompress      = false;
+  m_CompressorSettings.bRMSDetection  = true;
+  m_CompressorSettings.fThreshold     = -24.0f;
+  m_CompressorSettings.fRatio         = 4.0f;
+  m_CompressorSettings.fAttack        = 10.0f;
+  m_CompressorSettings.fRelease       = 250.0f;
 }
 
 cDSPProcessor::~cDSPProcessor()
 {
-  for (masterModesMap::iterator it = m_MasterModesMap.begin(); it != m_MasterModesMap.end(); ++it)
-  {
-    delete it->second;
-  }
   m_MasterModesMap.clear();
+
+  for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
+    delete m_StreamPool[i];
+
+  delete m_Calibration;
 }
 
 bool cDSPProcessor::SupportsInputProcess() const
@@ -667,34 +1179,49 @@ bool cDSPProcessor::SupportsOutputResample() const
 
 bool cDSPProcessor::SupportsPostProcess() const
 {
-  return m_SpeakerCorrection;
+  return m_SpeakerCorrection || m_DialogueEnhancement;
 }
 
 bool cDSPProcessor::InitDSP()
 {
+  /* the stream objects are created once, a new stream only resets its slot */
   for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
+  {
     g_usedDSPs[i] = NULL;
+    if (m_StreamPool[i] == NULL)
+      m_StreamPool[i] = new cDSPProcessorStream(i);
+  }
 
-  /*!
-   * Reset all settings data to default
-   */
-  SetOutputGain(AE_DSP_CH_MAX, 0.0);
+  m_SpeakerCorrection = false;
 
-  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
-    m_SpeakerDelay[i] = 0;
+  /* Read setting "speaker_profile" from settings.xml */
+  if (!KODI->GetSetting("speaker_profile", &m_SpeakerProfile) || m_SpeakerProfile < 0 || m_SpeakerProfile >= SPEAKER_PROFILES)
+    m_SpeakerProfile = 0;
 
-  m_SpeakerCorrection = false;
+  /* Read the names of the speaker profiles, empty ones use the default */
+  char name[1024];
+  for (int profile = 0; profile < SPEAKER_PROFILES; ++profile)
+  {
+    CStdString settingName;
+    settingName.Format("speaker_profile_name_%i", profile + 1);
+    name[0] = 0;
+    if (KODI->GetSetting(settingName.c_str(), name))
+      m_SpeakerProfileName[profile] = name;
+  }
 
-  CDSPSettings settings;
+  /*!
+   * Load all calibration profiles, a new profile starts as copy of the first
+   */
+  CDSPSettings settings(0);
   settings.LoadSettingsData(-1, true);
+  LoadSpeakerProfile(0, settings);
 
-  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  for (int profile = 1; profile < SPEAKER_PROFILES; ++profile)
   {
-    SetOutputGain((AE_DSP_CHANNEL) i, settings.m_Settings.m_channels[i].iVolumeCorrection);
-
-    m_SpeakerDelay[i] = settings.m_Settings.m_channels[i].iDistanceCorrection;
-    if (m_SpeakerDelay[i] > m_SpeakerDelayMax)
-      m_SpeakerDelayMax = m_SpeakerDelay[i];
+    CDSPSettings profileSettings(profile);
+    profileSettings.m_Settings = settings.m_Settings;
+    profileSettings.LoadSettingsData(-1, true);
+    LoadSpeakerProfile(profile, profileSettings);
   }
 
   AE_DSP_MENUHOOK hook;
@@ -721,8 +1248,28 @@ bool cDSPProcessor::InitDSP()
     hook.iRelevantModeId    = ID_POST_PROCESS_SPEAKER_CORRECTION;
     hook.bNeedPlayback      = true;
     ADSP->AddMenuHook(&hook);
+
+    hook.iHookId            = ID_MENU_SPEAKER_PROFILE;
+    hook.category           = AE_DSP_MENUHOOK_POST_PROCESS;
+    hook.iLocalizedStringId = 30120;
+    hook.iRelevantModeId    = ID_POST_PROCESS_SPEAKER_CORRECTION;
+    hook.bNeedPlayback      = false;
+    ADSP->AddMenuHook(&hook);
+
+    hook.iHookId            = ID_MENU_SPEAKER_CALIBRATION;
+    hook.category           = AE_DSP_MENUHOOK_POST_PROCESS;
+    hook.iLocalizedStringId = 30101;
+    hook.iRelevantModeId    = ID_POST_PROCESS_SPEAKER_CORRECTION;
+    hook.bNeedPlayback      = false;
+    ADSP->AddMenuHook(&hook);
   }
 
+  /* Read setting "calibration_capture" from settings.xml, the calibration
+   * itself is only started by its menu hook */
+  name[0] = 0;
+  if (KODI->GetSetting("calibration_capture", name))
+    m_CalibrationCapture = name;
+
   /* Read setting "master_stereo" from settings.xml */
   bool enable = false;
   if (!KODI->GetSetting("master_stereo", &enable))
@@ -733,7 +1280,67 @@ bool cDSPProcessor::InitDSP()
   }
   EnableMasterProcessor(ID_MASTER_PROCESS_STEREO_DOWNMIX, enable);
 
+  /* Read setting "master_pipeline" from settings.xml */
+  if (!KODI->GetSetting("master_pipeline", &m_MasterPipelining))
+    m_MasterPipelining = false;
+
+  /* Read setting "stream_presets" from settings.xml */
+  if (!KODI->GetSetting("stream_presets", &m_StreamPresets))
+    m_StreamPresets = false;
+
+  /* Read dynamic range control settings from settings.xml */
+  if (!KODI->GetSetting("dynamic_range", &m_DynamicRange))
+  {
+    /* If setting is unknown fallback to defaults */
+    KODI->Log(LOG_ERROR, "Couldn't get 'dynamic_range' setting, falling back to 'limiter' as default");
+    m_DynamicRange = DYNAMIC_RANGE_DEFAULT;
+  }
+  int value;
+  if (KODI->GetSetting("compressor_detection", &value))
+    m_CompressorSettings.bRMSDetection = value == 0;
+  if (KODI->GetSetting("compressor_threshold", &value))
+    m_CompressorSettings.fThreshold = (float)value;
+  if (KODI->GetSetting("compressor_ratio", &value))
+    m_CompressorSettings.fRatio = (float)value;
+  if (KODI->GetSetting("compressor_attack", &value))
+    m_CompressorSettings.fAttack = (float)value;
+  if (KODI->GetSetting("compressor_release", &value))
+    m_CompressorSettings.fRelease = (float)value;
+
+  /* Read setting "loudness_normalization" from settings.xml */
+  if (!KODI->GetSetting("loudness_normalization", &m_LoudnessNormalization))
+  {
+    /* If setting is unknown fallback to defaults */
+    KODI->Log(LOG_ERROR, "Couldn't get 'loudness_normalization' setting, falling back to 'false' as default");
+    m_LoudnessNormalization = LOUDNESS_NORMALIZATION_DEFAULT;
+  }
+  if (!KODI->GetSetting("loudness_target", &m_LoudnessTarget))
+    m_LoudnessTarget = LOUDNESS_TARGET_DEFAULT;
+
+  /* Read dialogue enhancement settings from settings.xml */
+  if (!KODI->GetSetting("dialogue_enhancement", &m_DialogueEnhancement))
+    m_DialogueEnhancement = false;
+  if (!KODI->GetSetting("dialogue_boost", &m_DialogueBoost))
+    m_DialogueBoost = DIALOGUE_BOOST_DEFAULT;
+  if (!KODI->GetSetting("dialogue_ducking", &m_DialogueDucking))
+    m_DialogueDucking = DIALOGUE_DUCKING_DEFAULT;
+
   struct AE_DSP_MODES::AE_DSP_MODE modeInfoStruct;
+  modeInfoStruct.iModeType              = AE_DSP_MODE_TYPE_PRE_PROCESS;
+  modeInfoStruct.iUniqueDBModeId        = -1;         // set by RegisterMode
+  modeInfoStruct.iModeNumber            = ID_PRE_PROCESS_LOUDNESS_NORMALIZATION;
+  modeInfoStruct.bHasSettingsDialog     = false;
+  modeInfoStruct.iModeDescription       = 30094;
+  modeInfoStruct.iModeHelp              = -1;
+  modeInfoStruct.iModeName              = 30093;
+  modeInfoStruct.iModeSetupName         = -1;
+  modeInfoStruct.iModeSupportTypeFlags  = AE_DSP_PRSNT_ASTREAM_BASIC | AE_DSP_PRSNT_ASTREAM_MUSIC | AE_DSP_PRSNT_ASTREAM_MOVIE;
+  strncpy(modeInfoStruct.strModeName, "Loudness normalization", sizeof(modeInfoStruct.strModeName) - 1);
+  memset(modeInfoStruct.strOwnModeImage, 0, sizeof(modeInfoStruct.strOwnModeImage)); // unused
+  memset(modeInfoStruct.strOverrideModeImage, 0, sizeof(modeInfoStruct.strOverrideModeImage)); // unused
+
+  ADSP->RegisterMode(&modeInfoStruct);
+
   modeInfoStruct.iModeType              = AE_DSP_MODE_TYPE_POST_PROCESS;
   modeInfoStruct.iUniqueDBModeId        = -1;         // set by RegisterMode
   modeInfoStruct.iModeNumber            = ID_POST_PROCESS_SPEAKER_CORRECTION;
@@ -749,17 +1356,35 @@ bool cDSPProcessor::InitDSP()
 
   ADSP->RegisterMode(&modeInfoStruct);
 
+  modeInfoStruct.iModeType              = AE_DSP_MODE_TYPE_POST_PROCESS;
+  modeInfoStruct.iUniqueDBModeId        = -1;         // set by RegisterMode
+  modeInfoStruct.iModeNumber            = ID_POST_PROCESS_DIALOGUE_ENHANCEMENT;
+  modeInfoStruct.bHasSettingsDialog     = false;
+  modeInfoStruct.iModeDescription       = 30098;
+  modeInfoStruct.iModeHelp              = -1;
+  modeInfoStruct.iModeName              = 30097;
+  modeInfoStruct.iModeSetupName         = -1;
+  modeInfoStruct.iModeSupportTypeFlags  = AE_DSP_PRSNT_ASTREAM_BASIC | AE_DSP_PRSNT_ASTREAM_MOVIE;
+  strncpy(modeInfoStruct.strModeName, "Dialogue enhancement", sizeof(modeInfoStruct.strModeName) - 1);
+  memset(modeInfoStruct.strOwnModeImage, 0, sizeof(modeInfoStruct.strOwnModeImage)); // unused
+  memset(modeInfoStruct.strOverrideModeImage, 0, sizeof(modeInfoStruct.strOverrideModeImage)); // unused
+
+  ADSP->RegisterMode(&modeInfoStruct);
+
   return true;
 }
 
 void cDSPProcessor::DestroyDSP()
 {
   for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
-    SAFE_DELETE(g_usedDSPs[i]);
+  {
+    g_usedDSPs[i] = NULL;
+    SAFE_DELETE(m_StreamPool[i]);
+  }
 
-  for (masterModesMap::iterator it = m_MasterModesMap.begin(); it != m_MasterModesMap.end(); it++)
-    delete it->second;
   m_MasterModesMap.clear();
+
+  SAFE_DELETE(m_Calibration);
 }
 
 bool cDSPProcessor::IsMasterProcessorEnabled(unsigned int masterId)
@@ -776,11 +1401,13 @@ bool cDSPProcessor::EnableMasterProcessor(unsigned int masterId, bool enable)
   masterModesMap::iterator it = m_MasterModesMap.find(masterId);
   if (enable && it == m_MasterModesMap.end())
   {
-    CDSPProcessMaster *proc = CDSPProcessMaster::AllocateMaster(0, masterId);
-    if (proc)
+    const sDSPMasterModeDescriptor *descriptor = CDSPMasterModeRegistry::Find(masterId);
+    if (descriptor)
     {
-      m_MasterModesMap.insert(make_pair(masterId, proc));
-      ADSP->RegisterMode(&proc->m_ModeInfoStruct);
+      AE_DSP_MODES::AE_DSP_MODE modeInfo;
+      CDSPMasterModeRegistry::GetModeInfo(descriptor, modeInfo);
+      ADSP->RegisterMode(&modeInfo);
+      m_MasterModesMap.insert(make_pair(masterId, modeInfo));
     }
     else
     {
@@ -790,8 +1417,7 @@ bool cDSPProcessor::EnableMasterProcessor(unsigned int masterId, bool enable)
   }
   else if (!enable && it != m_MasterModesMap.end())
   {
-    ADSP->UnregisterMode(&it->second->m_ModeInfoStruct);
-    delete it->second;
+    ADSP->UnregisterMode(&it->second);
     m_MasterModesMap.erase(it);
   }
 
@@ -824,6 +1450,28 @@ ADDON_STATUS cDSPProcessor::SetSetting(const char *settingName, const void *sett
     hook.bNeedPlayback      = true;
     hook.iRelevantModeId    = ID_POST_PROCESS_SPEAKER_CORRECTION;
 
+    if (m_SpeakerCorrection && !* (bool *) settingValue)
+      ADSP->RemoveMenuHook(&hook);
+    else if (!m_SpeakerCorrection && * (bool *) settingValue)
+      ADSP->AddMenuHook(&hook);
+
+    hook.iHookId            = ID_MENU_SPEAKER_PROFILE;
+    hook.category           = AE_DSP_MENUHOOK_POST_PROCESS;
+    hook.iLocalizedStringId = 30120;
+    hook.bNeedPlayback      = false;
+    hook.iRelevantModeId    = ID_POST_PROCESS_SPEAKER_CORRECTION;
+
+    if (m_SpeakerCorrection && !* (bool *) settingValue)
+      ADSP->RemoveMenuHook(&hook);
+    else if (!m_SpeakerCorrection && * (bool *) settingValue)
+      ADSP->AddMenuHook(&hook);
+
+    hook.iHookId            = ID_MENU_SPEAKER_CALIBRATION;
+    hook.category           = AE_DSP_MENUHOOK_POST_PROCESS;
+    hook.iLocalizedStringId = 30101;
+    hook.bNeedPlayback      = false;
+    hook.iRelevantModeId    = ID_POST_PROCESS_SPEAKER_CORRECTION;
+
     if (m_SpeakerCorrection && !* (bool *) settingValue)
       ADSP->RemoveMenuHook(&hook);
     else if (!m_SpeakerCorrection && * (bool *) settingValue)
@@ -832,11 +1480,88 @@ ADDON_STATUS cDSPProcessor::SetSetting(const char *settingName, const void *sett
     KODI->Log(LOG_INFO, "Changed Setting 'speaker_correction' from %u to %u", m_SpeakerCorrection, * (bool *) settingValue);
     m_SpeakerCorrection = * (bool *) settingValue;
   }
+  else if (str == "speaker_profile")
+  {
+    KODI->Log(LOG_INFO, "Changed Setting 'speaker_profile' from %i to %i", m_SpeakerProfile, * (int *) settingValue);
+    SetSpeakerProfile(* (int *) settingValue);
+  }
+  else if (str == "calibration_capture")
+  {
+    /* used by the next run of the calibration menu hook */
+    KODI->Log(LOG_INFO, "Changed Setting 'calibration_capture' to '%s'", (const char *) settingValue);
+    m_CalibrationCapture = (const char *) settingValue;
+  }
+  else if (str.compare(0, 21, "speaker_profile_name_") == 0)
+  {
+    int profile = atoi(str.c_str() + 21) - 1;
+    KODI->Log(LOG_INFO, "Changed Setting '%s' to '%s'", settingName, (const char *) settingValue);
+    if (profile >= 0 && profile < SPEAKER_PROFILES)
+      m_SpeakerProfileName[profile] = (const char *) settingValue;
+  }
   else if (str == "master_stereo")
   {
     KODI->Log(LOG_INFO, "Changed Setting 'master_stereo' from %u to %u", IsMasterProcessorEnabled(ID_MASTER_PROCESS_STEREO_DOWNMIX), * (bool *) settingValue);
     EnableMasterProcessor(ID_MASTER_PROCESS_STEREO_DOWNMIX, * (bool *) settingValue);
   }
+  else if (str == "master_pipeline")
+  {
+    /* used by the next initialized stream */
+    KODI->Log(LOG_INFO, "Changed Setting 'master_pipeline' from %u to %u", m_MasterPipelining, * (bool *) settingValue);
+    m_MasterPipelining = * (bool *) settingValue;
+  }
+  else if (str == "stream_presets")
+  {
+    /* used by the next created stream */
+    KODI->Log(LOG_INFO, "Changed Setting 'stream_presets' from %u to %u", m_StreamPresets, * (bool *) settingValue);
+    m_StreamPresets = * (bool *) settingValue;
+  }
+  else if (str == "loudness_normalization")
+  {
+    KODI->Log(LOG_INFO, "Changed Setting 'loudness_normalization' from %u to %u", m_LoudnessNormalization, * (bool *) settingValue);
+    SetLoudnessNormalization(* (bool *) settingValue, m_LoudnessTarget);
+  }
+  else if (str == "loudness_target")
+  {
+    KODI->Log(LOG_INFO, "Changed Setting 'loudness_target' from %i to %i", m_LoudnessTarget, * (int *) settingValue);
+    SetLoudnessNormalization(m_LoudnessNormalization, * (int *) settingValue);
+  }
+  else if (str == "dynamic_range")
+  {
+    KODI->Log(LOG_INFO, "Changed Setting 'dynamic_range' from %i to %i", m_DynamicRange, * (int *) settingValue);
+    SetDynamicRange(* (int *) settingValue, m_CompressorSettings);
+  }
+  else if (str.compare(0, 11, "compressor_") == 0)
+  {
+    sCompressorSettings settings = m_CompressorSettings;
+    int value = * (int *) settingValue;
+    if (str == "compressor_detection")
+      settings.bRMSDetection = value == 0;
+    else if (str == "compressor_threshold")
+      settings.fThreshold = (float)value;
+    else if (str == "compressor_ratio")
+      settings.fRatio = (float)value;
+    else if (str == "compressor_attack")
+      settings.fAttack = (float)value;
+    else if (str == "compressor_release")
+      settings.fRelease = (float)value;
+    KODI->Log(LOG_INFO, "Changed Setting '%s' to %i", settingName, value);
+    SetDynamicRange(m_DynamicRange, settings);
+  }
+  else if (str == "dialogue_enhancement")
+  {
+    KODI->Log(LOG_INFO, "Changed Setting 'dialogue_enhancement' from %u to %u", m_DialogueEnhancement, * (bool *) settingValue);
+    SetDialogueEnhancement(* (bool *) settingValue, m_DialogueBoost, m_DialogueDucking);
+  }
+  else if (str == "dialogue_boost")
+  {
+    KODI->Log(LOG_INFO, "Changed Setting 'dialogue_boost' from %i to %i", m_DialogueBoost, * (int *) settingValue);
+    SetDialogueEnhancement(m_DialogueEnhancement, * (int *) settingValue, m_DialogueDucking);
+  }
+  else if (str == "dialogue_ducking")
+  {
+    KODI->Log(LOG_INFO, "Changed Setting 'dialogue_ducking' from %i to %i", m_DialogueDucking, * (int *) settingValue);
+    SetDialogueEnhancement(m_DialogueEnhancement, m_DialogueBoost, * (int *) settingValue);
+  }
 
   return ADDON_STATUS_OK;
 }
@@ -845,21 +1570,51 @@ AE_DSP_ERROR cDSPProcessor::CallMenuHook(const AE_DSP_MENUHOOK &menuhook, const
 {
   if (menuhook.iHookId == ID_MENU_SPEAKER_GAIN_SETUP && m_SpeakerCorrection)
   {
-    CGUIDialogSpeakerGain settings(item.data.iStreamId);
+    CGUIDialogSpeakerGain settings(item.data.iStreamId, GetSpeakerProfile());
     settings.DoModal();
   }
   else if (menuhook.iHookId == ID_MENU_SPEAKER_DISTANCE_SETUP && m_SpeakerCorrection)
   {
-    CGUIDialogSpeakerDistance settings(item.data.iStreamId);
+    CGUIDialogSpeakerDistance settings(item.data.iStreamId, GetSpeakerProfile());
     settings.DoModal();
   }
+  else if (menuhook.iHookId == ID_MENU_SPEAKER_PROFILE && m_SpeakerCorrection)
+  {
+    int profile = (GetSpeakerProfile() + 1) % SPEAKER_PROFILES;
+    SetSpeakerProfile(profile);
+
+    /* SetSetting only applies the profile again */
+    KODI->SetSetting("speaker_profile", &profile);
+
+    char *msg = KODI->GetLocalizedString(30121);
+    KODI->QueueNotification(QUEUE_INFO, msg, GetSpeakerProfileName(profile).c_str());
+    KODI->FreeString(msg);
+  }
+  else if (menuhook.iHookId == ID_MENU_SPEAKER_CALIBRATION && m_SpeakerCorrection)
+  {
+    std::string captureFile;
+    {
+      CLockObject lock(m_Mutex);
+      captureFile = m_CalibrationCapture;
+    }
+
+    /* The calibration analysis must not hold the processing lock */
+    if (captureFile.empty())
+      KODI->Log(LOG_INFO, "Running calibration with the generated signal as capture");
+    else
+      KODI->Log(LOG_INFO, "Running calibration with capture file '%s'", captureFile.c_str());
+    RunCalibration(captureFile);
+  }
   return AE_DSP_ERROR_NO_ERROR;
 }
 
-void cDSPProcessor::SetOutputGain(AE_DSP_CHANNEL channel, float GainCoeff)
+void cDSPProcessor::SetOutputGain(AE_DSP_CHANNEL channel, float GainCoeff, int profile)
 {
   CLockObject lock(m_Mutex);
 
+  if (profile < 0)
+    profile = m_SpeakerProfile;
+
   GainCoeff = GainToScale(GainCoeff);
   if (GainCoeff > 2.0)
     GainCoeff = 2.0;
@@ -869,46 +1624,340 @@ void cDSPProcessor::SetOutputGain(AE_DSP_CHANNEL channel, float GainCoeff)
   if (channel == AE_DSP_CH_MAX)
   {
     for (unsigned i = 0; i < AE_DSP_CH_MAX; ++i)
-      g_DSPProcessor.m_OutputGain[i] = GainCoeff;
+      g_DSPProcessor.m_OutputGain[profile][i] = GainCoeff;
   }
   else if (channel < AE_DSP_CH_MAX && channel > AE_DSP_CH_INVALID)
-    g_DSPProcessor.m_OutputGain[channel] = GainCoeff;
+    g_DSPProcessor.m_OutputGain[profile][channel] = GainCoeff;
+
+  for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
+  {
+    if (g_usedDSPs[i] != NULL)
+      g_usedDSPs[i]->UpdateRouting(profile);
+  }
 }
 
 void cDSPProcessor::SetDelay(AE_DSP_CHANNEL channel, unsigned int delay)
 {
-  CLockObject lock(m_Mutex);
+  /* a new or longer line needs memory, it is allocated without the lock so
+   * the post process is only held off for the copy and the swap. The lines
+   * are only read under the lock, they can go away in between */
+  bool            hasLine[AE_DSP_STREAM_MAX_STREAMS];
+  CDelay         *created[AE_DSP_STREAM_MAX_STREAMS];
+  CDelay::sGrow   grow[AE_DSP_STREAM_MAX_STREAMS];
+  unsigned int    samplingRate[AE_DSP_STREAM_MAX_STREAMS];
+  unsigned int    padding[AE_DSP_STREAM_MAX_STREAMS];
+  {
+    CLockObject lock(m_Mutex);
 
-  m_SpeakerDelay[channel] = delay;
+    for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
+    {
+      cDSPProcessorStream *stream = g_usedDSPs[i];
+      hasLine[i]          = stream && stream->m_Delay[channel];
+      samplingRate[i]     = stream ? stream->m_Settings.iProcessSamplerate : 0;
+      padding[i]          = stream ? stream->m_Latency.GetPadding(channel, stream->m_Settings.lOutChannelPresentFlags) : 0;
+      grow[i].pBuffer     = NULL;
+      grow[i].iBufferSize = 0;
+      if (hasLine[i])
+        stream->m_Delay[channel]->BeginGrow(delay, grow[i]);
+    }
+  }
 
-  if (delay > m_SpeakerDelayMax)
-    m_SpeakerDelayMax = delay;
-  else
+  for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
   {
-    m_SpeakerDelayMax = 0;
-    for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+    created[i] = NULL;
+    if (hasLine[i])
+      CDelay::PrepareGrow(grow[i]);
+    else if (samplingRate[i] > 0 && delay > 0)
     {
-      if (m_SpeakerDelay[i] > m_SpeakerDelayMax)
-        m_SpeakerDelayMax = m_SpeakerDelay[i];
+      created[i] = new CDelay;
+      created[i]->Init(delay, samplingRate[i]);
+      created[i]->SetPadding(padding[i]);
     }
   }
 
+  DSPSample *previous[AE_DSP_STREAM_MAX_STREAMS];
+  {
+    CLockObject lock(m_Mutex);
+
+    int profile = m_SpeakerProfile;
+    m_SpeakerDelay[profile][channel] = delay;
+
+    for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
+    {
+      previous[i] = grow[i].pBuffer;
+      cDSPProcessorStream *stream = g_usedDSPs[i];
+      if (stream == NULL)
+        continue;
+
+      /* the stream can have changed in between, CommitGrow only takes the
+       * prepared ring if the line there still needs it */
+      CDelay *&streamLine = stream->m_Delay[channel];
+      if (streamLine && grow[i].pBuffer)
+        previous[i] = streamLine->CommitGrow(grow[i]);
+      else if (created[i] && streamLine == NULL && stream->m_Settings.iProcessSamplerate == samplingRate[i])
+      {
+        streamLine = created[i];
+        created[i] = NULL;
+      }
+      stream->UpdateDelay(channel);
+    }
+  }
+
+  for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
+  {
+    delete[] previous[i];
+    delete created[i];
+  }
+}
+
+void cDSPProcessor::SetSpeakerProfile(int profile)
+{
+  CLockObject lock(m_Mutex);
+
+  if (profile < 0 || profile >= SPEAKER_PROFILES)
+    return;
+
+  /* the streams have the stages of every profile ready and switch over */
+  m_SpeakerProfile = profile;
+  for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
+  {
+    if (g_usedDSPs[i] != NULL)
+      g_usedDSPs[i]->SetSpeakerProfile(profile);
+  }
+  KODI->Log(LOG_INFO, "Speaker profile '%s' active", GetSpeakerProfileName(profile).c_str());
+}
+
+std::string cDSPProcessor::GetSpeakerProfileName(int profile) const
+{
+  if (!m_SpeakerProfileName[profile].empty())
+    return m_SpeakerProfileName[profile];
+
+  CStdString name;
+  char *label = KODI->GetLocalizedString(30112 + profile);
+  name = label;
+  KODI->FreeString(label);
+  return name;
+}
+
+void cDSPProcessor::LoadSpeakerProfile(int profile, const CDSPSettings &settings)
+{
+  SetOutputGain(AE_DSP_CH_MAX, 0.0, profile);
+
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    const sDSPSettings::sDSPChannel &channel = settings.m_Settings.m_channels[i];
+
+    SetOutputGain((AE_DSP_CHANNEL) i, channel.iVolumeCorrection, profile);
+
+    m_SpeakerDelay[profile][i] = channel.iDistanceCorrection;
+
+    m_OutputPolarity[profile][i]   = channel.bPolarityInverted ? -1.0f : 1.0f;
+    m_AllPassFrequency[profile][i] = channel.iAllPassFrequency;
+    m_AllPassQ[profile][i]         = channel.iAllPassQ;
+  }
+}
+
+void cDSPProcessor::SetDynamicRange(int mode, const sCompressorSettings &settings)
+{
+  CLockObject lock(m_Mutex);
+
+  m_DynamicRange        = mode;
+  m_CompressorSettings  = settings;
+
   for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
   {
     if (g_usedDSPs[i] != NULL)
-      g_usedDSPs[i]->UpdateDelay(channel);
+      g_usedDSPs[i]->UpdateCompressor();
+  }
+}
+
+void cDSPProcessor::SetLoudnessNormalization(bool enable, int target)
+{
+  CLockObject lock(m_Mutex);
+
+  bool changed            = enable != m_LoudnessNormalization;
+  m_LoudnessNormalization = enable;
+  m_LoudnessTarget        = target;
+
+  /* target changes are picked up on next block, only a toggle needs the streams */
+  if (!changed)
+    return;
+
+  for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
+  {
+    if (g_usedDSPs[i] != NULL)
+      g_usedDSPs[i]->UpdateLoudness();
+  }
+}
+
+void cDSPProcessor::SetDialogueEnhancement(bool enable, int boost, int ducking)
+{
+  CLockObject lock(m_Mutex);
+
+  m_DialogueEnhancement = enable;
+  m_DialogueBoost   = boost;
+  m_DialogueDucking = ducking;
+
+  for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
+  {
+    if (g_usedDSPs[i] != NULL)
+      g_usedDSPs[i]->UpdateDialogue();
   }
 }
 
 void cDSPProcessor::SetTestSound(AE_DSP_CHANNEL channel, int mode, CGUIDialogSpeakerGain *cbClass, bool continues)
+{
+  cDSPProcessorSoundTest *released[AE_DSP_STREAM_MAX_STREAMS] = { NULL };
+  {
+    CLockObject lock(m_Mutex);
+
+    if (mode == SOUND_TEST_SWEEP)
+    {
+      if (continues)
+        StartCalibration(m_outChannelPresentFlags);
+      else if (channel > AE_DSP_CH_INVALID && channel < AE_DSP_CH_MAX)
+        StartCalibration(1 << channel);
+    }
+
+    for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
+    {
+      if (g_usedDSPs[i] != NULL)
+        released[i] = g_usedDSPs[i]->SetTestSound(channel, mode, cbClass, continues);
+    }
+  }
+
+  /* the prefetch thread may be decoding or calling back into the dialog,
+   * it is joined without blocking PostProcess */
+  for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
+    delete released[i];
+}
+
+void cDSPProcessor::StartCalibration(unsigned long channelPresentFlags)
 {
   CLockObject lock(m_Mutex);
 
+  unsigned int samplingRate = DEFAULT_SAMPLING_RATE;
   for (int i = 0; i < AE_DSP_STREAM_MAX_STREAMS; ++i)
   {
     if (g_usedDSPs[i] != NULL)
-      g_usedDSPs[i]->SetTestSound(channel, mode, cbClass, continues);
+    {
+      samplingRate = g_usedDSPs[i]->m_Settings.iProcessSamplerate;
+      break;
+    }
+  }
+
+  delete m_Calibration;
+  m_Calibration = new cDSPCalibration(channelPresentFlags, samplingRate);
+}
+
+bool cDSPProcessor::RunCalibration(const std::string &captureFile)
+{
+  std::vector<float> capture;
+  cDSPCalibration *calibration = NULL;
+  unsigned long channelPresentFlags;
+
+  /* take the session out of the audio path while analysing */
+  {
+    CLockObject lock(m_Mutex);
+    if (m_Calibration && (!captureFile.empty() || m_Calibration->IsFinished()))
+    {
+      calibration   = m_Calibration;
+      m_Calibration = NULL;
+    }
+    channelPresentFlags = m_outChannelPresentFlags;
+  }
+
+  if (captureFile.empty())
+  {
+    if (calibration)
+      capture = calibration->GetLoopbackCapture();
+    else
+      KODI->Log(LOG_ERROR, "Calibration: no finished sweep session to analyse");
+  }
+  else
+  {
+    unsigned int samplingRate;
+    if (!cDSPCalibration::LoadWaveFile(captureFile, capture, samplingRate))
+    {
+      delete calibration;
+      calibration = NULL;
+    }
+    else if (!calibration || calibration->GetSamplingRate() != samplingRate)
+    {
+      /* the schedule only depends on the channels and the rate, rebuild it if the capture differs */
+      delete calibration;
+      calibration = NULL;
+      if (channelPresentFlags != 0)
+        calibration = new cDSPCalibration(channelPresentFlags, samplingRate);
+      else
+        KODI->Log(LOG_ERROR, "Calibration: speaker layout is unknown until a stream was played");
+    }
+  }
+
+  /* the loopback capture is the generated sweep itself, it always comes out
+   * flat and must not replace the calibration of the profile */
+  bool dryRun = captureFile.empty();
+
+  bool ret = false;
+  if (calibration)
+  {
+    ret = calibration->Analyse(capture);
+    if (ret)
+      ApplyCalibration(*calibration, !dryRun);
+    else
+      KODI->Log(LOG_ERROR, "Calibration: analysis of the capture failed");
+  }
+
+  char *msg = KODI->GetLocalizedString(!ret ? 30103 : dryRun ? 30125 : 30102);
+  KODI->QueueNotification(ret ? QUEUE_INFO : QUEUE_ERROR, msg);
+  KODI->FreeString(msg);
+
+  CLockObject lock(m_Mutex);
+  if (m_Calibration == NULL)
+    m_Calibration = calibration;
+  else
+    delete calibration;
+
+  return ret;
+}
+
+void cDSPProcessor::ApplyCalibration(const cDSPCalibration &calibration, bool apply)
+{
+  CDSPSettings settings(GetSpeakerProfile());
+  if (apply)
+    settings.LoadSettingsData();
+  else
+    KODI->Log(LOG_INFO, "Calibration: loopback test, the results are not applied");
+
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    const sCalibrationResult &result = calibration.GetResult((AE_DSP_CHANNEL)i);
+    if (!result.bValid)
+      continue;
+
+    if (apply)
+    {
+      settings.m_Settings.m_channels[i].iChannelNumber      = i;
+      settings.m_Settings.m_channels[i].iVolumeCorrection   = result.iVolumeCorrection;
+      settings.m_Settings.m_channels[i].iDistanceCorrection = result.iDistanceCorrection;
+
+      SetOutputGain((AE_DSP_CHANNEL)i, result.iVolumeCorrection);
+      SetDelay((AE_DSP_CHANNEL)i, result.iDistanceCorrection);
+    }
+
+    CStdString eq;
+    for (unsigned int band = 0; band < CALIBRATION_EQ_BANDS; ++band)
+    {
+      CStdString value;
+      value.Format(" %.0fHz:%+.1f", cDSPCalibration::GetEQBandFrequency(band), result.fEQProposal[band]);
+      eq += value;
+    }
+    KODI->Log(LOG_INFO, "Calibration: channel %i level %+i dB, delay %i us, EQ proposal%s",
+              i, result.iVolumeCorrection, result.iDistanceCorrection, eq.c_str());
   }
+
+  if (apply)
+    settings.SaveSettingsData();
 }
 
 CDSPProcessMaster *cDSPProcessor::GetProcessMaster(unsigned streamId)
@@ -922,3 +1971,11 @@ CDSPProcessMaster *cDSPProcessor::GetProcessMaster(unsigned streamId)
   return g_usedDSPs[streamId]->m_MasterCurrrentMode;
 }
 
+cDSPProcessorStream *cDSPProcessor::GetPooledStream(unsigned int streamId)
+{
+  if (streamId >= AE_DSP_STREAM_MAX_STREAMS)
+    return NULL;
+
+  return m_StreamPool[streamId];
+}
+
@@ -27,8 +27,15 @@
 #include "p8-platform/threads/threads.h"
 #include "p8-platform/threads/mutex.h"
 #include "filter/delay.h"
+#include "filter/compressor.h"
+#include "filter/loudness.h"
+#include "filter/dialogue.h"
+#include "filter/softclamp.h"
 
 #include "DSPProcessMaster.h"
+#include "DSPMasterPipeline.h"
+#include "DSPStreamPreset.h"
+#include "DSPLatencyManager.h"
 
 // Maximal channels
 #define MAX_CHANNEL 16
@@ -41,20 +48,83 @@
 #define SPEAKER_GAIN_RANGE_DB_MIN -12
 #define SPEAKER_GAIN_RANGE_DB_MAX +6
 
+#define SPEAKER_PROFILES          4       //!< Calibration profiles, the streams build the stages of the active one
+
+#define ALLPASS_Q_SCALE           100
+#define ALLPASS_Q_DEFAULT         71      //!< Q of 0.71 scaled by ALLPASS_Q_SCALE
+#define ALLPASS_Q_MIN             10      //!< Lowest Q accepted from the settings file
+#define ALLPASS_Q_MAX             2000    //!< Highest Q accepted from the settings file
+
+#define LOUDNESS_NORMALIZATION_DEFAULT false
+#define LOUDNESS_TARGET_DEFAULT   -23     //!< LUFS, EBU R128
+#define LOUDNESS_GAIN_DB_MIN      -20
+#define LOUDNESS_GAIN_DB_MAX      +12
+#define LOUDNESS_GAIN_SMOOTH_TIME 3.0f    //!< Time constant of the normalization gain in seconds
+#define LOUDNESS_GAIN_DB_UNITY    0.01f   //!< Normalization gains below are not applied
+
+#define SILENCE_LEVEL             1e-10f  //!< About -200 dBFS, blocks below count as silent
+#define SILENCE_DECAY             13.8f   //!< Time constants until a filter tail is 120 dB down
+#define SILENCE_DIALOGUE_TAIL     0.1f    //!< Seconds the dialogue band filters ring out
+
+#define DIALOGUE_BOOST_DEFAULT    6       //!< dB
+#define DIALOGUE_DUCKING_DEFAULT  4       //!< dB
+
+#define DYNAMIC_RANGE_DEFAULT     DYNAMIC_RANGE_LIMITER
+
 // Convert a value in dB's to a coefficent
 #define DB_CO(g) ((g) > -90.0f ? powf(10.0f, (g) * 0.05f) : 0.0f)
 #define CO_DB(v) (20.0f * log10f(v))
 
 extern std::string g_strAddonPath;
-extern std::string GetSettingsFile();
+extern std::string GetSettingsFile(int profile = 0);
 
 class cDSPProcessor;
 class cDSPProcessorSoundTest;
+class cDSPSoundTestPrefetch;
+class cDSPCalibration;
 class CGUIDialogSpeakerGain;
+class CDSPSettings;
 
 using namespace P8PLATFORM;
 
-typedef std::map<unsigned int, CDSPProcessMaster *> masterModesMap;
+typedef std::map<unsigned int, AE_DSP_MODES::AE_DSP_MODE> masterModesMap;   //!< Enabled modes with their registration on KODI
+
+/*!
+ * Present channels of a stream as dense lists, built once in StreamInitialize
+ * so the processing stages touch only the channels which exist. The speaker
+ * correction parameters are kept per entry of the output list.
+ */
+struct sChannelRouting
+{
+  unsigned int    iInCount;
+  unsigned int    iOutCount;
+  AE_DSP_CHANNEL  iIn[AE_DSP_CH_MAX];           //!< Present input channels
+  AE_DSP_CHANNEL  iOut[AE_DSP_CH_MAX];          //!< Present output channels
+
+  bool            bUnity;                       //!< No gain, polarity, all-pass or delay on any output channel
+  float           fGain[AE_DSP_CH_MAX];         //!< Output gain with polarity, in order of iOut
+  Cfilter        *pAllPass[AE_DSP_CH_MAX];
+  CDelay         *pDelay[AE_DSP_CH_MAX];
+
+  unsigned int    iTailLength[AE_DSP_CH_MAX];   //!< Samples of all-pass and delay ring out
+  unsigned int    iTailLeft[AE_DSP_CH_MAX];     //!< Samples left until a silent channel is flushed
+  bool            bIdle[AE_DSP_CH_MAX];         //!< Channel bypassed in the last block
+};
+
+/*!
+ * Speaker correction of one calibration profile in order of the output list.
+ * It is prepared for every profile on StreamInitialize and kept up to date
+ * by the setters, a profile switch copies it into sChannelRouting between
+ * two blocks.
+ */
+struct sProfileRouting
+{
+  bool            bUnity;
+  float           fGain[AE_DSP_CH_MAX];
+  Cfilter        *pAllPass[AE_DSP_CH_MAX];
+  CDelay         *pDelay[AE_DSP_CH_MAX];
+  unsigned int    iTailLength[AE_DSP_CH_MAX];
+};
 
 class cDSPProcessorStream
 {
@@ -73,6 +143,12 @@ public:
   AE_DSP_ERROR StreamIsModeSupported(AE_DSP_MODE_TYPE mode_type, unsigned int mode_id, int unique_db_mode_id);
   AE_DSP_ERROR StreamInitialize(const AE_DSP_SETTINGS *settings);
 
+  /*!
+   * Clear the audio history of the stream for the next use of the pooled
+   * object, delay lines and filters stay allocated
+   */
+  void Reset();
+
   /*!
    * Pre processing related functions before pre resampling.
    * all enabled dsp addons called todo it
@@ -136,32 +212,67 @@ private:
   int                       m_iIdentifier;        /*!< @brief (required) audio stream id inside player */
   int                       m_iChannels;          /*!< @brief (required) amount of basic channels */
   int                       m_iSampleRate;        /*!< @brief (required) input sample rate */
+  sDSPStreamPreset          m_Preset;             /*!< @brief stage parameters for this kind of stream, resolved on StreamCreate */
 
   /*!
    * Internal processing functions
    */
 public:
   void UpdateDelay(AE_DSP_CHANNEL channel);
-  void SetTestSound(AE_DSP_CHANNEL channel, int mode, CGUIDialogSpeakerGain *cbClass = NULL, bool continues = false);
+  void UpdateAllPass(AE_DSP_CHANNEL channel, int profile);
+  void UpdateRouting(int profile);
+  void SetSpeakerProfile(int profile);
+  void UpdateCompressor();
+  void UpdateLoudness();
+  void UpdateDialogue();
+  /*!
+   * Returns the sound test taken out of the stream, the caller deletes it
+   * after the processor lock is released as it joins the prefetch thread
+   */
+  cDSPProcessorSoundTest *SetTestSound(AE_DSP_CHANNEL channel, int mode, CGUIDialogSpeakerGain *cbClass = NULL, bool continues = false);
   AE_DSP_SETTINGS *GetStreamSettings();
 
 private:
   friend class cDSPProcessor;
 
-  unsigned int CopyInToOut(float **array_in, float **array_out, unsigned int samples);
-  void PostProcessChannelSample(AE_DSP_CHANNEL channel, float **array_out, int pos);
-
-  float SoftClamp(float x);
+  typedef void (cDSPProcessorStream::*PostProcessKernel)(float **array_out, unsigned int samples);
 
-  CDelay                           *m_Delay[AE_DSP_CH_MAX];
+  unsigned int CopyInToOut(float **array_in, float **array_out, unsigned int samples);
+  void UpdateMasterPipeline();
+  void UpdateLatency();
+  void ActivateProfile(int profile);
+  void PrepareProfiles();
+  void UpdatePostProcessKernel();
+  template <bool LIMITED> void PostProcessChannels(float **array_out, unsigned int samples);
+  template <bool LIMITED> inline void PostProcessChannel(unsigned int index, float *data, unsigned int samples);
+
+  static bool IsSilent(const float *data, unsigned int samples);
+  bool UpdateTail(bool silent, unsigned int &tailLeft, unsigned int tailLength, unsigned int samples);
+
+  CDelay                           *m_Delay[AE_DSP_CH_MAX]; //!< Shared by the profiles, the ring holds the longest delay of them
+  Cfilter                          *m_AllPass[SPEAKER_PROFILES][AE_DSP_CH_MAX];
+  sProfileRouting                   m_ProfileRouting[SPEAKER_PROFILES];
+  CDSPLatencyManager                m_Latency;          //!< Stage latencies the speaker delay lines pad out
+  int                               m_Profile;          //!< Speaker profile copied into m_Routing
+  CCompressor                      *m_Compressor;
+  CLoudnessMeter                   *m_LoudnessMeter;
+  float                             m_LoudnessGainDB;   //!< Current smoothed normalization gain
+  unsigned int                      m_MasterTailLeft;   //!< Samples until the master mode is flushed on silence
+  unsigned int                      m_CompressorTailLeft;
+  unsigned int                      m_DialogueTailLeft;
+  CDialogueEnhancer                *m_Dialogue;
+  PostProcessKernel                 m_PostProcessKernel;
+  sChannelRouting                   m_Routing;
 
   unsigned int                      m_ProcessSamplerate;
   unsigned int                      m_ProcessSamplesize;
   double                            m_ProcessSourceRatio;
 
   cDSPProcessorSoundTest           *m_SoundTest;
-  std::vector<CDSPProcessMaster*>   m_MasterModes;
-  CDSPProcessMaster                *m_MasterCurrrentMode;
+  std::vector<unsigned int>         m_MasterModes;      //!< Ids of the enabled modes which support the stream
+  CDSPProcessMaster                *m_MasterCurrrentMode; //!< Only the selected mode is instantiated
+  CDSPMasterPipeline               *m_MasterPipeline;   //!< Set if the current mode runs on a worker thread
+  P8PLATFORM::CMutex                m_MasterMutex;      //!< Held by MasterProcess, mode and pipeline are swapped under it
 };
 
 /*!
@@ -184,10 +295,18 @@ public:
   void DestroyDSP();
   ADDON_STATUS SetSetting(const char *settingName, const void *settingValue);
   AE_DSP_ERROR CallMenuHook(const AE_DSP_MENUHOOK &menuhook, const AE_DSP_MENUHOOK_DATA &item);
-  void SetOutputGain(AE_DSP_CHANNEL channel, float GainCoeff);
+  void SetOutputGain(AE_DSP_CHANNEL channel, float GainCoeff, int profile = -1);
   void SetDelay(AE_DSP_CHANNEL channel, unsigned int delay);
+  void SetDynamicRange(int mode, const sCompressorSettings &settings);
+  void SetLoudnessNormalization(bool enable, int target);
+  void SetDialogueEnhancement(bool enable, int boost, int ducking);
+  void SetSpeakerProfile(int profile);
+  int GetSpeakerProfile() const { return m_SpeakerProfile; }
+  std::string GetSpeakerProfileName(int profile) const;
   void SetTestSound(AE_DSP_CHANNEL channel, int mode, CGUIDialogSpeakerGain *cbClass = NULL, bool continues = false);
+  bool RunCalibration(const std::string &captureFile);
   CDSPProcessMaster *GetProcessMaster(unsigned streamId);
+  cDSPProcessorStream *GetPooledStream(unsigned int streamId);
 
   void SetOutChannelPresentFlags(unsigned long flags) { m_outChannelPresentFlags = flags; }
   unsigned long GetOutChannelPresentFlags() { return m_outChannelPresentFlags; }
@@ -195,19 +314,41 @@ public:
 protected:
   friend class cDSPProcessorStream;
   friend class cDSPProcessorSoundTest;
+  friend class cDSPSoundTestPrefetch;
 
   bool IsMasterProcessorEnabled(unsigned int masterId);
   bool EnableMasterProcessor(unsigned int masterId, bool enable);
+  void StartCalibration(unsigned long channelPresentFlags);
+  void ApplyCalibration(const cDSPCalibration &calibration, bool apply);
+  void LoadSpeakerProfile(int profile, const CDSPSettings &settings);
 
   masterModesMap           m_MasterModesMap;
 
   AE_DSP_CHANNEL_PRESENT   m_CurrentOutChannelPresentFlags;
 
-  float                    m_OutputGain[AE_DSP_CH_MAX];
-  unsigned int             m_SpeakerDelay[AE_DSP_CH_MAX];
-  unsigned int             m_SpeakerDelayMax;
+  /* speaker correction, one set per calibration profile */
+  float                    m_OutputGain[SPEAKER_PROFILES][AE_DSP_CH_MAX];
+  float                    m_OutputPolarity[SPEAKER_PROFILES][AE_DSP_CH_MAX];   //!< 1.0 or -1.0
+  int                      m_AllPassFrequency[SPEAKER_PROFILES][AE_DSP_CH_MAX]; //!< Hz, 0 if off
+  int                      m_AllPassQ[SPEAKER_PROFILES][AE_DSP_CH_MAX];
+  unsigned int             m_SpeakerDelay[SPEAKER_PROFILES][AE_DSP_CH_MAX];
+  std::string              m_SpeakerProfileName[SPEAKER_PROFILES];              //!< Empty for the default name
+  int                      m_SpeakerProfile;                                    //!< Active profile
   bool                     m_SpeakerCorrection;
+  int                      m_DynamicRange;
+  sCompressorSettings      m_CompressorSettings;
+  bool                     m_LoudnessNormalization;
+  int                      m_LoudnessTarget;
+  bool                     m_DialogueEnhancement;
+  int                      m_DialogueBoost;
+  int                      m_DialogueDucking;
+  bool                     m_MasterPipelining;                //!< Run heavy master modes on a worker thread
+  bool                     m_StreamPresets;                   //!< Set the stages up by the kind of stream
+  CDSPStreamPresetResolver m_PresetResolver;
   unsigned long            m_outChannelPresentFlags;
+  cDSPCalibration         *m_Calibration;
+  std::string              m_CalibrationCapture;              //!< Recorded sweep response, empty to analyse the generated sweep
+  cDSPProcessorStream     *m_StreamPool[AE_DSP_STREAM_MAX_STREAMS];  //!< One object per stream slot, reused by every stream on it
 
   P8PLATFORM::CMutex         m_Mutex;
 };
@@ -0,0 +1,461 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "addon.h"
+#include "AudioDSPBasic.h"
+#include "AudioDSPCalibration.h"
+
+#if !defined(M_PI) && defined(TARGET_WINDOWS)
+  #define _USE_MATH_DEFINES
+  #include <cmath>
+#endif
+
+using namespace ADDON;
+
+cDSPCalibration::cDSPCalibration(unsigned long channelPresentFlags, unsigned int samplingRate)
+  : m_ChannelPresentFlags(channelPresentFlags)
+  , m_SamplingRate(samplingRate > 0 ? samplingRate : DEFAULT_SAMPLING_RATE)
+  , m_Position(0)
+  , m_Owner(NULL)
+{
+  memset(m_Results, 0, sizeof(m_Results));
+
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    if (m_ChannelPresentFlags & (1 << i))
+      m_Channels.push_back(i);
+  }
+
+  CreateSweep();
+
+  m_LeadIn        = (unsigned int)(CALIBRATION_LEAD_IN * m_SamplingRate);
+  m_SegmentLength = m_Sweep.size() + (unsigned int)(CALIBRATION_SWEEP_GAP * m_SamplingRate);
+  m_TotalLength   = m_LeadIn + m_SegmentLength * m_Channels.size();
+
+  m_Loopback.assign(m_TotalLength, 0.0f);
+}
+
+cDSPCalibration::~cDSPCalibration()
+{
+}
+
+float cDSPCalibration::GetEQBandFrequency(unsigned int band)
+{
+  return 31.25f * (float)(1 << band);
+}
+
+void cDSPCalibration::CreateSweep()
+{
+  /* Exponential sweep after A. Farina, the instantaneous frequency rises by a
+   * constant factor per time, so every octave gets the same energy. */
+  double f1       = CALIBRATION_SWEEP_START;
+  double f2       = CALIBRATION_SWEEP_END;
+  if (f2 > 0.45 * m_SamplingRate)
+    f2 = 0.45 * m_SamplingRate;
+
+  unsigned int length = (unsigned int)(CALIBRATION_SWEEP_TIME * m_SamplingRate);
+  unsigned int fade   = (unsigned int)(CALIBRATION_SWEEP_FADE * m_SamplingRate);
+  double rate         = log(f2 / f1);
+  double k            = 2.0 * M_PI * f1 * CALIBRATION_SWEEP_TIME / rate;
+
+  m_Sweep.resize(length);
+  for (unsigned int i = 0; i < length; ++i)
+  {
+    double t      = (double)i / m_SamplingRate;
+    double value  = sin(k * (exp(t / CALIBRATION_SWEEP_TIME * rate) - 1.0));
+
+    if (i < fade)
+      value *= 0.5 - 0.5 * cos(M_PI * i / fade);
+    else if (i >= length - fade)
+      value *= 0.5 - 0.5 * cos(M_PI * (length - i) / fade);
+
+    m_Sweep[i] = (float)value * CALIBRATION_SWEEP_LEVEL;
+  }
+}
+
+AE_DSP_CHANNEL cDSPCalibration::Process(float **array_out, unsigned int samples, const void *owner)
+{
+  if (m_Owner == NULL)
+    m_Owner = owner;
+  if (m_Owner != owner || IsFinished())
+    return AE_DSP_CH_INVALID;
+
+  AE_DSP_CHANNEL current = AE_DSP_CH_INVALID;
+  unsigned int pos = 0;
+  while (pos < samples && m_Position < m_TotalLength)
+  {
+    if (m_Position < m_LeadIn)
+    {
+      unsigned int length = m_LeadIn - m_Position;
+      if (length > samples - pos)
+        length = samples - pos;
+      pos         += length;
+      m_Position  += length;
+      current      = (AE_DSP_CHANNEL)m_Channels[0];
+      continue;
+    }
+
+    unsigned int segment  = (m_Position - m_LeadIn) / m_SegmentLength;
+    unsigned int offset   = (m_Position - m_LeadIn) % m_SegmentLength;
+    unsigned int length   = m_SegmentLength - offset;
+    if (length > samples - pos)
+      length = samples - pos;
+
+    current = (AE_DSP_CHANNEL)m_Channels[segment];
+    if (offset < m_Sweep.size())
+    {
+      unsigned int copy = m_Sweep.size() - offset;
+      if (copy > length)
+        copy = length;
+      memcpy(array_out[current] + pos, &m_Sweep[offset], copy * sizeof(float));
+      memcpy(&m_Loopback[m_Position], &m_Sweep[offset], copy * sizeof(float));
+    }
+
+    pos         += length;
+    m_Position  += length;
+  }
+
+  return IsFinished() ? AE_DSP_CH_INVALID : current;
+}
+
+bool cDSPCalibration::LoadWaveFile(const std::string &file, std::vector<float> &capture, unsigned int &samplingRate)
+{
+  void *handle = KODI->OpenFile(file.c_str(), 0);
+  if (!handle)
+  {
+    KODI->Log(LOG_ERROR, "Calibration: couldn't open capture file '%s'", file.c_str());
+    return false;
+  }
+
+  std::vector<unsigned char> data((size_t)KODI->GetFileLength(handle));
+  size_t read = 0;
+  while (read < data.size())
+  {
+    ssize_t ret = KODI->ReadFile(handle, &data[read], data.size() - read);
+    if (ret <= 0)
+      break;
+    read += ret;
+  }
+  KODI->CloseFile(handle);
+  data.resize(read);
+
+  if (data.size() < 12 || memcmp(&data[0], "RIFF", 4) != 0 || memcmp(&data[8], "WAVE", 4) != 0)
+  {
+    KODI->Log(LOG_ERROR, "Calibration: '%s' is no RIFF wave file", file.c_str());
+    return false;
+  }
+
+  unsigned int format   = 0;
+  unsigned int channels = 0;
+  unsigned int bits     = 0;
+  samplingRate = 0;
+
+  size_t pos = 12;
+  while (pos + 8 <= data.size())
+  {
+    const unsigned char *chunk = &data[pos];
+    size_t size = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((size_t)chunk[7] << 24);
+    pos += 8;
+    if (size > data.size() - pos)
+      size = data.size() - pos;
+
+    if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16)
+    {
+      const unsigned char *fmt = &data[pos];
+      format        = fmt[0] | (fmt[1] << 8);
+      channels      = fmt[2] | (fmt[3] << 8);
+      samplingRate  = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | ((unsigned int)fmt[7] << 24);
+      bits          = fmt[14] | (fmt[15] << 8);
+      if (format == 0xFFFE && size >= 26)   // WAVE_FORMAT_EXTENSIBLE, sub format follows
+        format = fmt[24] | (fmt[25] << 8);
+    }
+    else if (memcmp(chunk, "data", 4) == 0 && channels > 0)
+    {
+      unsigned int bytes  = bits / 8;
+      if (!((format == 1 && (bytes == 2 || bytes == 3 || bytes == 4)) || (format == 3 && bytes == 4)))
+      {
+        KODI->Log(LOG_ERROR, "Calibration: unsupported wave format %u with %u bits", format, bits);
+        return false;
+      }
+
+      /* only the first channel is used, it carries the measurement microphone */
+      size_t frames = size / (bytes * channels);
+      const unsigned char *in = &data[pos];
+      capture.resize(frames);
+      for (size_t i = 0; i < frames; ++i, in += bytes * channels)
+      {
+        if (format == 3)
+        {
+          float value;
+          memcpy(&value, in, sizeof(float));
+          capture[i] = value;
+        }
+        else if (bytes == 2)
+          capture[i] = (float)(int16_t)(in[0] | (in[1] << 8)) / 32768.0f;
+        else if (bytes == 3)
+          capture[i] = (float)((int32_t)((in[0] << 8) | (in[1] << 16) | ((uint32_t)in[2] << 24)) >> 8) / 8388608.0f;
+        else
+          capture[i] = (float)(int32_t)(in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24)) / 2147483648.0f;
+      }
+      return samplingRate > 0;
+    }
+
+    pos += size + (size & 1);
+  }
+
+  KODI->Log(LOG_ERROR, "Calibration: no audio data found in '%s'", file.c_str());
+  return false;
+}
+
+bool cDSPCalibration::Deconvolve(const std::vector<float> &capture, int start, unsigned int length, unsigned int fftSize, std::vector<double> &ir)
+{
+  if (!m_FFT.Init(fftSize))
+    return false;
+
+  if (m_SweepRe.size() != fftSize)
+  {
+    m_SweepRe.assign(fftSize, 0.0);
+    m_SweepIm.assign(fftSize, 0.0);
+    for (unsigned int i = 0; i < m_Sweep.size() && i < fftSize; ++i)
+      m_SweepRe[i] = m_Sweep[i];
+    m_FFT.Forward(&m_SweepRe[0], &m_SweepIm[0]);
+  }
+
+  m_Re.assign(fftSize, 0.0);
+  m_Im.assign(fftSize, 0.0);
+  for (unsigned int i = 0; i < length && i < fftSize; ++i)
+  {
+    int pos = start + (int)i;
+    if (pos >= 0 && pos < (int)capture.size())
+      m_Re[i] = capture[pos];
+  }
+  m_FFT.Forward(&m_Re[0], &m_Im[0]);
+
+  /* Regularized spectral division, bins outside of the sweep range stay
+   * near zero instead of amplifying the noise floor. */
+  double maxPower = 0.0;
+  for (unsigned int i = 0; i < fftSize; ++i)
+  {
+    double power = m_SweepRe[i] * m_SweepRe[i] + m_SweepIm[i] * m_SweepIm[i];
+    if (power > maxPower)
+      maxPower = power;
+  }
+  double epsilon = maxPower * 1e-4;
+
+  for (unsigned int i = 0; i < fftSize; ++i)
+  {
+    double sr     = m_SweepRe[i];
+    double si     = m_SweepIm[i];
+    double denom  = sr * sr + si * si + epsilon;
+    double re     = (m_Re[i] * sr + m_Im[i] * si) / denom;
+    double im     = (m_Im[i] * sr - m_Re[i] * si) / denom;
+    m_Re[i] = re;
+    m_Im[i] = im;
+  }
+  m_FFT.Inverse(&m_Re[0], &m_Im[0]);
+
+  ir.assign(m_Re.begin(), m_Re.end());
+  return true;
+}
+
+double cDSPCalibration::BandLevel(unsigned int fftSize, double freqLow, double freqHigh) const
+{
+  unsigned int first  = (unsigned int)ceil(freqLow * fftSize / m_SamplingRate);
+  unsigned int last   = (unsigned int)floor(freqHigh * fftSize / m_SamplingRate);
+  if (last >= fftSize / 2)
+    last = fftSize / 2 - 1;
+  if (first < 1)
+    first = 1;
+  if (last < first)
+    last = first;
+
+  double power = 0.0;
+  for (unsigned int i = first; i <= last; ++i)
+    power += m_Re[i] * m_Re[i] + m_Im[i] * m_Im[i];
+  power /= (last - first + 1);
+
+  return power > 0.0 ? 10.0 * log10(power) : -200.0;
+}
+
+void cDSPCalibration::AnalyseChannel(AE_DSP_CHANNEL channel, const std::vector<double> &ir, unsigned int peak)
+{
+  unsigned int pre    = m_SamplingRate / 1000;
+  unsigned int window = (unsigned int)(CALIBRATION_IR_WINDOW * m_SamplingRate);
+  unsigned int fade   = window / 5;
+  unsigned int size   = CFFT::NextPowerOfTwo(window);
+
+  /* take the direct sound and the early reflections, fade out the tail */
+  m_Re.assign(size, 0.0);
+  m_Im.assign(size, 0.0);
+  for (unsigned int i = 0; i < window; ++i)
+  {
+    int pos = (int)peak - (int)pre + (int)i;
+    if (pos < 0 || pos >= (int)ir.size())
+      continue;
+
+    double value = ir[pos];
+    if (i >= window - fade)
+      value *= 0.5 + 0.5 * cos(M_PI * (i - (window - fade)) / fade);
+    m_Re[i] = value;
+  }
+
+  CFFT fft;
+  fft.Init(size);
+  fft.Forward(&m_Re[0], &m_Im[0]);
+
+  sCalibrationResult &result = m_Results[channel];
+  if (channel == AE_DSP_CH_LFE)
+    result.fLevelDB = (float)BandLevel(size, 30.0, 120.0);
+  else
+    result.fLevelDB = (float)BandLevel(size, 500.0, 2000.0);
+
+  for (unsigned int band = 0; band < CALIBRATION_EQ_BANDS; ++band)
+  {
+    double center = GetEQBandFrequency(band);
+    result.fEQProposal[band] = 0.0f;
+
+    if (center * M_SQRT2 > 0.45 * m_SamplingRate || center < CALIBRATION_SWEEP_START)
+      continue;
+    if (channel == AE_DSP_CH_LFE && center > 250.0)
+      continue;
+
+    float correction = result.fLevelDB - (float)BandLevel(size, center * M_SQRT1_2, center * M_SQRT2);
+    if (correction > CALIBRATION_EQ_RANGE)
+      correction = CALIBRATION_EQ_RANGE;
+    else if (correction < -CALIBRATION_EQ_RANGE)
+      correction = -CALIBRATION_EQ_RANGE;
+    result.fEQProposal[band] = correction;
+  }
+}
+
+bool cDSPCalibration::Analyse(const std::vector<float> &capture)
+{
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+    m_Results[i].bValid = false;
+
+  if (m_Channels.empty() || capture.size() < m_SegmentLength)
+    return false;
+
+  std::vector<double> ir;
+
+  /* Locate the first sweep, the recording may start before the playback */
+  unsigned int length = (unsigned int)(CALIBRATION_MAX_PREROLL * m_SamplingRate) + m_LeadIn + m_SegmentLength;
+  if (length > capture.size())
+    length = capture.size();
+  if (!Deconvolve(capture, 0, length, CFFT::NextPowerOfTwo(length), ir))
+    return false;
+
+  unsigned int base = 0;
+  for (unsigned int i = 1; i < length; ++i)
+  {
+    if (fabs(ir[i]) > fabs(ir[base]))
+      base = i;
+  }
+
+  /* Every channel is deconvolved on its own segment, the segment of the
+   * next channel is cut off so only this speaker is seen. */
+  unsigned int margin = (unsigned int)(CALIBRATION_ARRIVAL_MARGIN * m_SamplingRate);
+  length = m_SegmentLength + margin;
+  unsigned int fftSize = CFFT::NextPowerOfTwo(length);
+
+  for (unsigned int k = 0; k < m_Channels.size(); ++k)
+  {
+    AE_DSP_CHANNEL channel = (AE_DSP_CHANNEL)m_Channels[k];
+    int start = (int)(base + k * m_SegmentLength) - (int)margin;
+    if (start + length > capture.size())
+    {
+      KODI->Log(LOG_ERROR, "Calibration: capture ends before the sweep of channel %i", channel);
+      break;
+    }
+
+    if (!Deconvolve(capture, start, length, fftSize, ir))
+      return false;
+
+    unsigned int peak = 0;
+    double energy = 0.0;
+    for (unsigned int i = 0; i < length; ++i)
+    {
+      energy += ir[i] * ir[i];
+      if (fabs(ir[i]) > fabs(ir[peak]))
+        peak = i;
+    }
+    double rms = sqrt(energy / length);
+    if (rms <= 0.0 || fabs(ir[peak]) / rms < CALIBRATION_MIN_SNR)
+    {
+      KODI->Log(LOG_ERROR, "Calibration: no clear impulse found for channel %i", channel);
+      continue;
+    }
+
+    m_Results[channel].fArrival = (float)peak - (float)margin;
+    AnalyseChannel(channel, ir, peak);
+    m_Results[channel].bValid = true;
+  }
+
+  /* Distance: delay every channel to the one arriving last */
+  float latest    = -1e9f;
+  float reference = 0.0f;
+  unsigned int references = 0;
+  for (unsigned int k = 0; k < m_Channels.size(); ++k)
+  {
+    const sCalibrationResult &result = m_Results[m_Channels[k]];
+    if (!result.bValid)
+      continue;
+    if (result.fArrival > latest)
+      latest = result.fArrival;
+    if (m_Channels[k] != AE_DSP_CH_LFE)
+    {
+      reference += result.fLevelDB;
+      ++references;
+    }
+  }
+  if (references == 0 && m_Results[AE_DSP_CH_LFE].bValid)
+  {
+    reference   = m_Results[AE_DSP_CH_LFE].fLevelDB;
+    references  = 1;
+  }
+  if (references == 0)
+    return false;
+  reference /= references;
+
+  /* snap to the grid of the distance dialog */
+  const unsigned int step     = M_TO_DELAY(0.5);
+  const unsigned int maxDelay = M_TO_DELAY(MAX_SPEAKER_DISTANCE_METER);
+  for (unsigned int k = 0; k < m_Channels.size(); ++k)
+  {
+    sCalibrationResult &result = m_Results[m_Channels[k]];
+    if (!result.bValid)
+      continue;
+
+    double delay = (latest - result.fArrival) * DELAY_RESOLUTION / m_SamplingRate;
+    unsigned int distance = ROUND(delay / step) * step;
+    result.iDistanceCorrection = distance > maxDelay ? maxDelay : distance;
+
+    int volume = (int)floor(reference - result.fLevelDB + 0.5f);
+    if (volume < SPEAKER_GAIN_RANGE_DB_MIN)
+      volume = SPEAKER_GAIN_RANGE_DB_MIN;
+    else if (volume > SPEAKER_GAIN_RANGE_DB_MAX)
+      volume = SPEAKER_GAIN_RANGE_DB_MAX;
+    result.iVolumeCorrection = volume;
+  }
+
+  return true;
+}
@@ -0,0 +1,117 @@
+#pragma once
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Automatic room calibration.
+ *
+ * A session plays one exponential sine sweep per present channel, each
+ * followed by a gap for the room decay. The recorded response of the whole
+ * session (a WAV file from a measurement microphone, or the loopback of the
+ * generated signal as stand-in) is deconvolved per channel with the FFT.
+ * The impulse responses give the relative arrival time (distance), the level
+ * and an octave band EQ proposal for every channel.
+ */
+
+#include <string>
+#include <vector>
+
+#include "kodi_adsp_types.h"
+#include "filter/fft.h"
+
+#define CALIBRATION_SWEEP_START     20.0      //!< Hz
+#define CALIBRATION_SWEEP_END       20000.0   //!< Hz, limited to 0.45 of the sample rate
+#define CALIBRATION_SWEEP_TIME      3.0       //!< Seconds per channel
+#define CALIBRATION_SWEEP_GAP       1.0       //!< Seconds of silence after each sweep
+#define CALIBRATION_SWEEP_FADE      0.01      //!< Seconds of fade in and out
+#define CALIBRATION_SWEEP_LEVEL     0.5f
+#define CALIBRATION_LEAD_IN         0.5       //!< Seconds of silence before the first sweep
+#define CALIBRATION_MAX_PREROLL     10.0      //!< Seconds the capture may start before the playback
+#define CALIBRATION_ARRIVAL_MARGIN  0.25      //!< Seconds a channel may arrive before the first one
+#define CALIBRATION_IR_WINDOW       0.3       //!< Seconds of impulse response used for level and EQ
+#define CALIBRATION_MIN_SNR         10.0      //!< Impulse peak against the response RMS
+#define CALIBRATION_EQ_BANDS        10        //!< Octave bands from 31.25 Hz to 16 kHz
+#define CALIBRATION_EQ_RANGE        12.0f     //!< dB
+
+struct sCalibrationResult
+{
+  bool  bValid;
+  int   iDistanceCorrection;                  //!< in DELAY_RESOLUTION, as sDSPSettings::sDSPChannel
+  int   iVolumeCorrection;                    //!< in dB, as sDSPSettings::sDSPChannel
+  float fLevelDB;                             //!< Measured level of the reference band
+  float fArrival;                             //!< Arrival relative to the schedule in samples
+  float fEQProposal[CALIBRATION_EQ_BANDS];    //!< Correction in dB per octave band
+};
+
+class cDSPCalibration
+{
+public:
+  cDSPCalibration(unsigned long channelPresentFlags, unsigned int samplingRate);
+  ~cDSPCalibration();
+
+  /*!
+   * Playback, called from the audio thread with cleared outputs. The first
+   * caller owns the session so several streams do not advance it twice.
+   * Returns the channel currently measured or AE_DSP_CH_INVALID at the end.
+   */
+  AE_DSP_CHANNEL Process(float **array_out, unsigned int samples, const void *owner);
+  bool IsFinished() const { return m_Position >= m_TotalLength; }
+
+  /*!
+   * Capture sources
+   */
+  static bool LoadWaveFile(const std::string &file, std::vector<float> &capture, unsigned int &samplingRate);
+  const std::vector<float> &GetLoopbackCapture() const { return m_Loopback; }
+
+  /*!
+   * Analysis, runs outside of the audio thread
+   */
+  bool Analyse(const std::vector<float> &capture);
+  const sCalibrationResult &GetResult(AE_DSP_CHANNEL channel) const { return m_Results[channel]; }
+
+  unsigned int GetSamplingRate() const { return m_SamplingRate; }
+  unsigned long GetChannelPresentFlags() const { return m_ChannelPresentFlags; }
+
+  static float GetEQBandFrequency(unsigned int band);
+
+private:
+  void CreateSweep();
+  bool Deconvolve(const std::vector<float> &capture, int start, unsigned int length, unsigned int fftSize, std::vector<double> &ir);
+  void AnalyseChannel(AE_DSP_CHANNEL channel, const std::vector<double> &ir, unsigned int peak);
+  double BandLevel(unsigned int fftSize, double freqLow, double freqHigh) const;
+
+  unsigned long             m_ChannelPresentFlags;
+  unsigned int              m_SamplingRate;
+  std::vector<int>          m_Channels;           //!< Measurement order
+  std::vector<float>        m_Sweep;
+  unsigned int              m_LeadIn;             //!< Samples
+  unsigned int              m_SegmentLength;      //!< Samples of sweep and gap
+  unsigned int              m_TotalLength;
+  unsigned int              m_Position;
+  const void               *m_Owner;
+  std::vector<float>        m_Loopback;
+
+  CFFT                      m_FFT;
+  std::vector<double>       m_SweepRe;            //!< Sweep spectrum for the current FFT size
+  std::vector<double>       m_SweepIm;
+  std::vector<double>       m_Re;
+  std::vector<double>       m_Im;
+
+  sCalibrationResult        m_Results[AE_DSP_CH_MAX];
+};
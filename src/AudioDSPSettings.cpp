@@ -17,6 +17,20 @@
  *
  */
 
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#if defined(TARGET_WINDOWS)
+  #include <windows.h>
+  #include <io.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+#endif
+
 #include "libXBMC_addon.h"
 #include "libKODI_adsp.h"
 #include "libKODI_guilib.h"
@@ -24,14 +38,220 @@
 #include "util/XMLUtils.h"
 #include "p8-platform/util/util.h"
 #include "p8-platform/util/StdString.h"
+#include "p8-platform/threads/mutex.h"
 
 #include "AudioDSPSettings.h"
 #include "GUIDialogSpeakerGain.h"
 
 using namespace std;
 using namespace ADDON;
+using namespace P8PLATFORM;
+
+#define SETTINGS_CACHE_HEADER_SIZE      32    //!< magic, version, channels, XML size and time, checksum
+#define SETTINGS_CACHE_RECORD_SIZE      25    //!< six int32 values and the name length
+
+/*
+ * Size and modification time of the XML file the settings were taken from.
+ * The time alone has a resolution of one second on many file systems, an
+ * edit inside the same second is only seen by the size.
+ */
+struct sSettingsFileStamp
+{
+  int64_t iSize;
+  int64_t iTime;
 
-CDSPSettings::CDSPSettings()
+  bool operator==(const sSettingsFileStamp &other) const { return iSize == other.iSize && iTime == other.iTime; }
+};
+
+/*
+ * Parsed channel settings of every speaker profile, shared by all CDSPSettings
+ * instances. The dialogs and the processor take them from here instead of
+ * reading the files again, a set is dropped if its XML file was changed
+ * from outside.
+ */
+static CMutex                       g_SettingsCacheLock;
+static bool                         g_SettingsCacheValid[SPEAKER_PROFILES];
+static sSettingsFileStamp           g_SettingsCacheStamp[SPEAKER_PROFILES];
+static sDSPSettings::sDSPChannel    g_SettingsCache[SPEAKER_PROFILES][AE_DSP_CH_MAX];
+
+static string GetSettingsCacheFile(int profile)
+{
+  string cacheFile = GetSettingsFile(profile);
+  size_t pos = cacheFile.rfind(".xml");
+  if (pos != string::npos)
+    cacheFile.erase(pos);
+  return cacheFile + ".bin";
+}
+
+static bool GetFileStamp(const string &path, sSettingsFileStamp &stamp)
+{
+  stamp.iSize = 0;
+  stamp.iTime = 0;
+
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0)
+    return false;
+  stamp.iSize = info.st_size;
+  stamp.iTime = info.st_mtime;
+  return true;
+}
+
+static uint32_t Checksum(const uint8_t *data, size_t size)
+{
+  /* FNV-1a */
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static void PutInt(string &data, int32_t value)
+{
+  uint32_t bits = (uint32_t)value;
+  for (int i = 0; i < 4; ++i)
+    data += (char)((bits >> (8 * i)) & 0xFF);
+}
+
+static int32_t GetInt(const uint8_t *data)
+{
+  return (int32_t)((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+}
+
+static void PutInt64(string &data, int64_t value)
+{
+  PutInt(data, (int32_t)(uint32_t)((uint64_t)value & 0xFFFFFFFF));
+  PutInt(data, (int32_t)(uint32_t)((uint64_t)value >> 32));
+}
+
+static int64_t GetInt64(const uint8_t *data)
+{
+  return (int64_t)((uint64_t)(uint32_t)GetInt(data) | ((uint64_t)(uint32_t)GetInt(data + 4) << 32));
+}
+
+/*!
+ * Open the temporary file which replaces path on CommitTempFile
+ */
+static FILE *OpenTempFile(const string &path)
+{
+  return fopen((path + ".tmp").c_str(), "wb");
+}
+
+/*!
+ * Bring the temporary file to the storage and rename it over path, after a
+ * power cut either the old or the new file is present, never a partial one
+ */
+static bool CommitTempFile(FILE *file, const string &path, bool written)
+{
+  string tmpFile = path + ".tmp";
+
+  written = written && fflush(file) == 0;
+#if defined(TARGET_WINDOWS)
+  written = written && _commit(_fileno(file)) == 0;
+#else
+  written = written && fsync(fileno(file)) == 0;
+#endif
+  written = fclose(file) == 0 && written;
+  if (!written)
+  {
+    remove(tmpFile.c_str());
+    return false;
+  }
+
+#if defined(TARGET_WINDOWS)
+  if (!MoveFileExA(tmpFile.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+  {
+    remove(tmpFile.c_str());
+    return false;
+  }
+#else
+  if (rename(tmpFile.c_str(), path.c_str()) != 0)
+  {
+    remove(tmpFile.c_str());
+    return false;
+  }
+
+  /* the rename itself is only durable with the directory entry synced */
+  size_t pos = path.find_last_of('/');
+  string directory = pos == string::npos ? "." : path.substr(0, pos + 1);
+  int fd = open(directory.c_str(), O_RDONLY);
+  if (fd >= 0)
+  {
+    fsync(fd);
+    close(fd);
+  }
+#endif
+
+  return true;
+}
+
+/* files written before the Q was stored carry 0, which the filter design can not use */
+static int LimitAllPassQ(int q)
+{
+  if (q <= 0)
+    return ALLPASS_Q_DEFAULT;
+  if (q < ALLPASS_Q_MIN)
+    return ALLPASS_Q_MIN;
+  if (q > ALLPASS_Q_MAX)
+    return ALLPASS_Q_MAX;
+  return q;
+}
+
+/*!
+ * xmlStamp is NULL if there is no XML file, the snapshot is then taken as it is
+ */
+static bool ParseSettingsCache(const uint8_t *data, size_t size, const sSettingsFileStamp *xmlStamp, sDSPSettings::sDSPChannel *channels)
+{
+  if (size < SETTINGS_CACHE_HEADER_SIZE ||
+      (uint32_t)GetInt(data) != SETTINGS_CACHE_MAGIC ||
+      GetInt(data + 4) != SETTINGS_CACHE_VERSION ||
+      (uint32_t)GetInt(data + 28) != Checksum(data + SETTINGS_CACHE_HEADER_SIZE, size - SETTINGS_CACHE_HEADER_SIZE))
+    return false;
+
+  /* the snapshot belongs to exactly this XML file, any other size or time
+   * means it was edited after the snapshot was written */
+  sSettingsFileStamp stamp;
+  stamp.iSize = GetInt64(data + 12);
+  stamp.iTime = GetInt64(data + 20);
+  if (xmlStamp && !(stamp == *xmlStamp))
+    return false;
+
+  int32_t count = GetInt(data + 8);
+  if (count < 0 || count > AE_DSP_CH_MAX)
+    return false;
+
+  const uint8_t *pos = data + SETTINGS_CACHE_HEADER_SIZE;
+  const uint8_t *end = data + size;
+  for (int32_t i = 0; i < count; ++i)
+  {
+    if (end - pos < SETTINGS_CACHE_RECORD_SIZE)
+      return false;
+
+    int32_t number = GetInt(pos);
+    unsigned int nameLength = pos[24];
+    if (number < 0 || number >= AE_DSP_CH_MAX || (size_t)(end - pos) < SETTINGS_CACHE_RECORD_SIZE + nameLength)
+      return false;
+
+    sDSPSettings::sDSPChannel &channel = channels[number];
+    channel.iChannelNumber          = number;
+    channel.iVolumeCorrection       = GetInt(pos + 4);
+    channel.iOldVolumeCorrection    = channel.iVolumeCorrection;
+    channel.iDistanceCorrection     = GetInt(pos + 8);
+    channel.iOldDistanceCorrection  = channel.iDistanceCorrection;
+    channel.bPolarityInverted       = GetInt(pos + 12) != 0;
+    channel.iAllPassFrequency       = GetInt(pos + 16);
+    channel.iAllPassQ               = LimitAllPassQ(GetInt(pos + 20));
+    channel.strName.assign((const char*)pos + SETTINGS_CACHE_RECORD_SIZE, nameLength);
+    pos += SETTINGS_CACHE_RECORD_SIZE + nameLength;
+  }
+
+  return pos == end;
+}
+
+CDSPSettings::CDSPSettings(int profile)
+  : m_Profile(profile >= 0 && profile < SPEAKER_PROFILES ? profile : 0)
 {
   for (int i = 0; i < MAX_CHANNEL; ++i)
   {
@@ -40,6 +260,9 @@ CDSPSettings::CDSPSettings()
     m_Settings.m_channels[i].iOldVolumeCorrection = 0;
     m_Settings.m_channels[i].iDistanceCorrection = 0;
     m_Settings.m_channels[i].iOldDistanceCorrection = 0;
+    m_Settings.m_channels[i].bPolarityInverted = false;
+    m_Settings.m_channels[i].iAllPassFrequency = 0;
+    m_Settings.m_channels[i].iAllPassQ = ALLPASS_Q_DEFAULT;
     m_Settings.m_channels[i].ptrSpinControl = NULL;
   }
 }
@@ -104,15 +327,184 @@ AE_DSP_CHANNEL CDSPSettings::TranslateGUIIdToChannelId(int controlId)
 }
 
 bool CDSPSettings::LoadSettingsData(int settingId, bool initial)
+{
+  if (settingId >= 0 && settingId != ID_MENU_SPEAKER_GAIN_SETUP && settingId != ID_MENU_SPEAKER_DISTANCE_SETUP)
+    return true;
+
+  CLockObject lock(g_SettingsCacheLock);
+
+  sSettingsFileStamp xmlStamp;
+  bool xmlPresent = GetFileStamp(GetSettingsFile(m_Profile), xmlStamp);
+  if (g_SettingsCacheValid[m_Profile] && (!xmlPresent || xmlStamp == g_SettingsCacheStamp[m_Profile]))
+  {
+    ApplyCachedSettings();
+    return true;
+  }
+
+  /* the binary snapshot is only used if it was written for the XML file as
+   * it is now, otherwise the XML was edited and is parsed to renew it */
+  if (LoadSettingsCache(xmlPresent ? &xmlStamp : NULL))
+  {
+    g_SettingsCacheStamp[m_Profile] = xmlStamp;
+    StoreCachedSettings();
+    return true;
+  }
+
+  if (!LoadSettingsXML(initial))
+    return false;
+
+  if (!SaveSettingsCache())
+    KODI->Log(LOG_ERROR, "failed to write speaker settings cache");
+
+  GetFileStamp(GetSettingsFile(m_Profile), g_SettingsCacheStamp[m_Profile]);
+  StoreCachedSettings();
+  return true;
+}
+
+bool CDSPSettings::SaveSettingsData()
+{
+  CLockObject lock(g_SettingsCacheLock);
+
+  if (!SaveSettingsXML())
+  {
+    KODI->Log(LOG_ERROR, "failed to write speaker settings data");
+    return false;
+  }
+
+  if (!SaveSettingsCache())
+    KODI->Log(LOG_ERROR, "failed to write speaker settings cache");
+
+  GetFileStamp(GetSettingsFile(m_Profile), g_SettingsCacheStamp[m_Profile]);
+  StoreCachedSettings();
+  return true;
+}
+
+void CDSPSettings::ApplyCachedSettings()
+{
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    CAddonGUISpinControl *spinControl = m_Settings.m_channels[i].ptrSpinControl;
+    m_Settings.m_channels[i] = g_SettingsCache[m_Profile][i];
+    m_Settings.m_channels[i].ptrSpinControl = spinControl;
+  }
+}
+
+void CDSPSettings::StoreCachedSettings()
+{
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    g_SettingsCache[m_Profile][i] = m_Settings.m_channels[i];
+    g_SettingsCache[m_Profile][i].iOldVolumeCorrection   = g_SettingsCache[m_Profile][i].iVolumeCorrection;
+    g_SettingsCache[m_Profile][i].iOldDistanceCorrection = g_SettingsCache[m_Profile][i].iDistanceCorrection;
+    g_SettingsCache[m_Profile][i].ptrSpinControl         = NULL;
+  }
+  g_SettingsCacheValid[m_Profile] = true;
+}
+
+bool CDSPSettings::LoadSettingsCache(const sSettingsFileStamp *xmlStamp)
+{
+  string strCacheFile = GetSettingsCacheFile(m_Profile);
+  sDSPSettings::sDSPChannel channels[AE_DSP_CH_MAX];
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+    channels[i] = m_Settings.m_channels[i];
+
+  bool valid = false;
+#if defined(TARGET_WINDOWS)
+  FILE *file = fopen(strCacheFile.c_str(), "rb");
+  if (!file)
+    return false;
+
+  vector<uint8_t> data;
+  uint8_t buffer[1024];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data.insert(data.end(), buffer, buffer + read);
+  fclose(file);
+
+  valid = !data.empty() && ParseSettingsCache(&data[0], data.size(), xmlStamp, channels);
+#else
+  int fd = open(strCacheFile.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0)
+  {
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED)
+    {
+      valid = ParseSettingsCache((const uint8_t*)data, info.st_size, xmlStamp, channels);
+      munmap(data, info.st_size);
+    }
+  }
+  close(fd);
+#endif
+
+  if (!valid)
+  {
+    KODI->Log(LOG_NOTICE, "speaker settings cache '%s' is invalid or outdated, using the XML data", strCacheFile.c_str());
+    return false;
+  }
+
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    CAddonGUISpinControl *spinControl = m_Settings.m_channels[i].ptrSpinControl;
+    m_Settings.m_channels[i] = channels[i];
+    m_Settings.m_channels[i].ptrSpinControl = spinControl;
+  }
+  return true;
+}
+
+bool CDSPSettings::SaveSettingsCache()
+{
+  string data;
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    const sDSPSettings::sDSPChannel &channel = m_Settings.m_channels[i];
+    size_t nameLength = channel.strName.size() < SETTINGS_CACHE_NAME_MAX ? channel.strName.size() : SETTINGS_CACHE_NAME_MAX;
+
+    PutInt(data, i);
+    PutInt(data, channel.iVolumeCorrection);
+    PutInt(data, channel.iDistanceCorrection);
+    PutInt(data, channel.bPolarityInverted ? 1 : 0);
+    PutInt(data, channel.iAllPassFrequency);
+    PutInt(data, channel.iAllPassQ);
+    data += (char)nameLength;
+    data.append(channel.strName, 0, nameLength);
+  }
+
+  /* written after the XML, so the stamp is the one of the saved file */
+  sSettingsFileStamp xmlStamp;
+  GetFileStamp(GetSettingsFile(m_Profile), xmlStamp);
+
+  string header;
+  PutInt(header, SETTINGS_CACHE_MAGIC);
+  PutInt(header, SETTINGS_CACHE_VERSION);
+  PutInt(header, AE_DSP_CH_MAX);
+  PutInt64(header, xmlStamp.iSize);
+  PutInt64(header, xmlStamp.iTime);
+  PutInt(header, Checksum((const uint8_t*)data.data(), data.size()));
+  data.insert(0, header);
+
+  string strCacheFile = GetSettingsCacheFile(m_Profile);
+  FILE *file = OpenTempFile(strCacheFile);
+  if (!file)
+    return false;
+
+  bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+  return CommitTempFile(file, strCacheFile, written);
+}
+
+bool CDSPSettings::LoadSettingsXML(bool initial)
 {
   TiXmlDocument xmlDoc;
-  string strSettingsFile = GetSettingsFile();
+  string strSettingsFile = GetSettingsFile(m_Profile);
 
   if (!xmlDoc.LoadFile(strSettingsFile))
   {
     if (initial)
     {
-      if (!SaveSettingsData())
+      if (!SaveSettingsXML())
       {
         KODI->Log(LOG_ERROR, "failed to create initial settings data file at '%s')", strSettingsFile.c_str());
         return false;
@@ -132,46 +524,57 @@ bool CDSPSettings::LoadSettingsData(int settingId, bool initial)
     return false;
   }
 
-  TiXmlElement *pElement = NULL;
-  if (settingId < 0 || settingId == ID_MENU_SPEAKER_GAIN_SETUP || settingId == ID_MENU_SPEAKER_DISTANCE_SETUP)
+  TiXmlElement *pElement = pRootElement->FirstChildElement("channels");
+  if (pElement)
   {
-    pElement = pRootElement->FirstChildElement("channels");
-    if (pElement)
+    TiXmlNode *pChannelNode = NULL;
+    while ((pChannelNode = pElement->IterateChildren(pChannelNode)) != NULL)
     {
-      TiXmlNode *pChannelNode = NULL;
-      while ((pChannelNode = pElement->IterateChildren(pChannelNode)) != NULL)
-      {
-        CStdString strTmp;
-        sDSPSettings::sDSPChannel channel;
+      CStdString strTmp;
+      sDSPSettings::sDSPChannel channel;
 
-        if (!XMLUtils::GetInt(pChannelNode, "number", channel.iChannelNumber))
-          continue;
+      if (!XMLUtils::GetInt(pChannelNode, "number", channel.iChannelNumber))
+        continue;
+      if (channel.iChannelNumber < 0 || channel.iChannelNumber >= AE_DSP_CH_MAX)
+        continue;
 
-        if (XMLUtils::GetString(pChannelNode, "name", strTmp))
-          channel.strName = strTmp;
-        else
-          channel.strName = "";
+      if (XMLUtils::GetString(pChannelNode, "name", strTmp))
+        channel.strName = strTmp;
+      else
+        channel.strName = "";
 
-        if (!XMLUtils::GetInt(pChannelNode, "volume", channel.iVolumeCorrection))
-          channel.iVolumeCorrection = 0;
+      if (!XMLUtils::GetInt(pChannelNode, "volume", channel.iVolumeCorrection))
+        channel.iVolumeCorrection = 0;
 
-        if (!XMLUtils::GetInt(pChannelNode, "distance", channel.iDistanceCorrection))
-          channel.iDistanceCorrection = 0;
+      if (!XMLUtils::GetInt(pChannelNode, "distance", channel.iDistanceCorrection))
+        channel.iDistanceCorrection = 0;
 
-        m_Settings.m_channels[channel.iChannelNumber].iChannelNumber          = channel.iChannelNumber;
-        m_Settings.m_channels[channel.iChannelNumber].iVolumeCorrection       = channel.iVolumeCorrection;
-        m_Settings.m_channels[channel.iChannelNumber].iOldVolumeCorrection    = channel.iVolumeCorrection;
-        m_Settings.m_channels[channel.iChannelNumber].strName                 = channel.strName;
-        m_Settings.m_channels[channel.iChannelNumber].iDistanceCorrection     = channel.iDistanceCorrection;
-        m_Settings.m_channels[channel.iChannelNumber].iOldDistanceCorrection  = channel.iDistanceCorrection;
-      }
+      if (!XMLUtils::GetBoolean(pChannelNode, "polarityinverted", channel.bPolarityInverted))
+        channel.bPolarityInverted = false;
+
+      if (!XMLUtils::GetInt(pChannelNode, "allpassfrequency", channel.iAllPassFrequency))
+        channel.iAllPassFrequency = 0;
+
+      if (!XMLUtils::GetInt(pChannelNode, "allpassq", channel.iAllPassQ))
+        channel.iAllPassQ = ALLPASS_Q_DEFAULT;
+      channel.iAllPassQ = LimitAllPassQ(channel.iAllPassQ);
+
+      m_Settings.m_channels[channel.iChannelNumber].iChannelNumber          = channel.iChannelNumber;
+      m_Settings.m_channels[channel.iChannelNumber].iVolumeCorrection       = channel.iVolumeCorrection;
+      m_Settings.m_channels[channel.iChannelNumber].iOldVolumeCorrection    = channel.iVolumeCorrection;
+      m_Settings.m_channels[channel.iChannelNumber].strName                 = channel.strName;
+      m_Settings.m_channels[channel.iChannelNumber].iDistanceCorrection     = channel.iDistanceCorrection;
+      m_Settings.m_channels[channel.iChannelNumber].iOldDistanceCorrection  = channel.iDistanceCorrection;
+      m_Settings.m_channels[channel.iChannelNumber].bPolarityInverted       = channel.bPolarityInverted;
+      m_Settings.m_channels[channel.iChannelNumber].iAllPassFrequency       = channel.iAllPassFrequency;
+      m_Settings.m_channels[channel.iChannelNumber].iAllPassQ               = channel.iAllPassQ;
     }
   }
 
   return true;
 }
 
-bool CDSPSettings::SaveSettingsData()
+bool CDSPSettings::SaveSettingsXML()
 {
   TiXmlDocument xmlDoc;
   TiXmlDeclaration * decl         = new TiXmlDeclaration("1.0", "", "");
@@ -185,6 +588,9 @@ bool CDSPSettings::SaveSettingsData()
     XMLUtils::SetString(pChannelNode, "name", m_Settings.m_channels[i].strName.c_str());
     XMLUtils::SetInt(pChannelNode, "volume", m_Settings.m_channels[i].iVolumeCorrection);
     XMLUtils::SetInt(pChannelNode, "distance", m_Settings.m_channels[i].iDistanceCorrection);
+    XMLUtils::SetBoolean(pChannelNode, "polarityinverted", m_Settings.m_channels[i].bPolarityInverted);
+    XMLUtils::SetInt(pChannelNode, "allpassfrequency", m_Settings.m_channels[i].iAllPassFrequency);
+    XMLUtils::SetInt(pChannelNode, "allpassq", m_Settings.m_channels[i].iAllPassQ);
     xmlChannelsSetting->LinkEndChild(pChannelNode);
   }
 
@@ -192,11 +598,11 @@ bool CDSPSettings::SaveSettingsData()
   xmlDoc.LinkEndChild(decl);
   xmlDoc.LinkEndChild(xmlRootElement);
 
-  if (!xmlDoc.SaveFile(GetSettingsFile()))
-  {
-    KODI->Log(LOG_ERROR, "failed to write speaker settings data");
+  string strSettingsFile = GetSettingsFile(m_Profile);
+  FILE *file = OpenTempFile(strSettingsFile);
+  if (!file)
     return false;
-  }
 
-  return true;
+  bool written = xmlDoc.SaveFile(file);
+  return CommitTempFile(file, strSettingsFile, written);
 }
@@ -44,6 +44,17 @@
 #define SPIN_CONTROL_SPEAKER_CH_BLOC    31
 #define SPIN_CONTROL_SPEAKER_CH_BROC    32
 
+/*
+ * The XML file stays the interchange format. Next to it a compact binary
+ * snapshot is kept which is mapped on startup instead of parsing the XML,
+ * it is rebuilt from the XML if missing, invalid or not written for the XML
+ * file of the same size and modification time. Both files are
+ * replaced atomically by writing a temporary file and renaming it.
+ */
+#define SETTINGS_CACHE_MAGIC            0x53534241  //!< "ABSS" little endian
+#define SETTINGS_CACHE_VERSION          2
+#define SETTINGS_CACHE_NAME_MAX         255
+
 class CAddonGUISpinControl;
 
 struct sDSPSettings
@@ -56,6 +67,9 @@ struct sDSPSettings
     int iOldVolumeCorrection;
     int iDistanceCorrection;
     int iOldDistanceCorrection;
+    bool bPolarityInverted;
+    int iAllPassFrequency;      /* Hz, 0 disables the phase correction */
+    int iAllPassQ;              /* scaled by ALLPASS_Q_SCALE */
     CAddonGUISpinControl *ptrSpinControl;
   };
 
@@ -78,10 +92,12 @@ struct sDSPSettings
   sDSPFreeSurround      m_FreeSurround;
 };
 
+struct sSettingsFileStamp;
+
 class CDSPSettings
 {
 public:
-  CDSPSettings();
+  CDSPSettings(int profile);        //!< Calibration profile to load and save
   virtual ~CDSPSettings() {};
 
   static AE_DSP_CHANNEL TranslateGUIIdToChannelId(int controlId);
@@ -91,4 +107,14 @@ public:
   bool SaveSettingsData();
 
   sDSPSettings m_Settings;
+
+private:
+  int m_Profile;
+
+  bool LoadSettingsXML(bool initial);
+  bool LoadSettingsCache(const sSettingsFileStamp *xmlStamp);
+  bool SaveSettingsXML();
+  bool SaveSettingsCache();
+  void ApplyCachedSettings();
+  void StoreCachedSettings();
 };
@@ -18,29 +18,38 @@
  */
 
 #include <string>
+#include <stdio.h>
+#include <string.h>
 #include "addon.h"
-#include "PinkNoise.h"
+#include "AudioDSPTestSignal.h"
 #include "GUIDialogSpeakerGain.h"
 #include "AudioDSPSoundTest.h"
+#include "AudioDSPCalibration.h"
 
 using namespace P8PLATFORM;
 using namespace ADDON;
 
-cDSPProcessorSoundTest::cDSPProcessorSoundTest(unsigned long outChannelPresentFlags, CGUIDialogSpeakerGain *cbClass)
+cDSPProcessorSoundTest::cDSPProcessorSoundTest(const sChannelRouting *routing, unsigned long outChannelPresentFlags, unsigned int samplingRate, CGUIDialogSpeakerGain *cbClass)
 {
+  m_Routing                 = routing;
   m_OutChannelPresentFlags  = outChannelPresentFlags;
+  m_SamplingRate            = samplingRate;
   m_currentTestPointer      = AE_DSP_CH_INVALID;
   m_currentTestMode         = SOUND_TEST_OFF;
   m_currentTestContinues    = false;
-  m_NoiseSource             = NULL;
-  m_TestSound               = NULL;
+  m_SamplesToSwitch         = 0;
+  m_Signal                  = NULL;
+  m_ClipPosition            = 0;
   m_ContinueTestCBClass     = cbClass;
+  m_Prefetch                = new cDSPSoundTestPrefetch(samplingRate, cbClass);
+  m_Prefetch->CreateThread();
 }
 
 cDSPProcessorSoundTest::~cDSPProcessorSoundTest()
 {
-  if (m_TestSound)
-    delete m_TestSound;
+  delete m_Prefetch;
+  if (m_Signal)
+    delete m_Signal;
 }
 
 std::string GetSoundFile(AE_DSP_CHANNEL channel)
@@ -113,150 +122,157 @@ void cDSPProcessorSoundTest::SetTestMode(int mode, AE_DSP_CHANNEL channel, bool
   if (!continues && m_currentTestContinues)
     mode = SOUND_TEST_OFF;
 
-  if (mode == SOUND_TEST_PINK_NOICE)
+  if (continues && mode != SOUND_TEST_OFF && mode != SOUND_TEST_SWEEP)
   {
-    if (!m_NoiseSource)
-      m_NoiseSource = new cPinkNoise;
-
-    if (continues)
-    {
-      m_lastContinuesChange = time(NULL);
-      channel = GetNextChannelPtr(AE_DSP_CH_LFE);
-      if (m_ContinueTestCBClass)
-        m_ContinueTestCBClass->ContinuesTestSwitchInfoCB(channel);
-    }
+    channel = GetNextChannelPtr(AE_DSP_CH_LFE);
+    if (m_ContinueTestCBClass)
+      m_ContinueTestCBClass->ContinuesTestSwitchInfoCB(channel);
   }
-  else if (mode == SOUND_TEST_VOICE)
+
+  int signal = GetTestSignal(mode);
+  if (signal >= 0)
   {
-    if (m_TestSound)
-      delete m_TestSound;
-    m_TestSound = ADSP->GetSoundPlay(GetSoundFile(channel).c_str());
-    m_TestSound->SetChannel(channel);
-    m_TestSound->SetVolume(g_DSPProcessor.m_OutputGain[channel]);
-    m_TestSound->Play();
-
-    if (continues)
-    {
-      m_lastContinuesChange = time(NULL);
-      channel = GetNextChannelPtr(AE_DSP_CH_LFE);
-      if (m_ContinueTestCBClass)
-        m_ContinueTestCBClass->ContinuesTestSwitchInfoCB(channel);
-    }
+    if (!m_Signal)
+      m_Signal = new cDSPTestSignal(m_SamplingRate);
+    m_Signal->SetSignal(signal, channel);
   }
   else
   {
-    if (m_NoiseSource)
-      delete m_NoiseSource;
-    m_NoiseSource = NULL;
+    if (m_Signal)
+      delete m_Signal;
+    m_Signal = NULL;
+
+    if (mode == SOUND_TEST_VOICE)
+      m_Prefetch->PostPrefetch(continues ? m_OutChannelPresentFlags : (1 << channel));
   }
 
   m_currentTestMode       = mode;
   m_currentTestPointer    = channel;
   m_currentTestContinues  = continues;
+  m_SamplesToSwitch       = GetContinuesPeriod();
+  m_ClipPosition          = 0;
+}
+
+unsigned int cDSPProcessorSoundTest::GetContinuesPeriod() const
+{
+  unsigned int period = (m_currentTestMode == SOUND_TEST_VOICE ? CONTINUES_SOUND_TEST_TIME : CONTINUES_PINK_NOISE_TIME) * m_SamplingRate;
+
+  /* repeated signals stay at least one full period on each channel */
+  if (m_Signal && m_Signal->GetPeriod() > period)
+    period = m_Signal->GetPeriod();
+  return period;
 }
 
-void cDSPProcessorSoundTest::SetTestVolume(float volume)
+void cDSPProcessorSoundTest::SwitchChannel(AE_DSP_CHANNEL channel)
 {
-  if (m_TestSound)
-    m_TestSound->SetVolume(g_DSPProcessor.m_OutputGain[m_currentTestPointer]);
+  m_currentTestPointer = channel;
+  m_SamplesToSwitch    = GetContinuesPeriod();
+  m_ClipPosition       = 0;
 
+  if (m_Signal)
+    m_Signal->SetChannel(channel);
+  m_Prefetch->PostSwitchInfo(channel);
 }
+
 unsigned int cDSPProcessorSoundTest::ProcessTestMode(float **array_in, float **array_out, unsigned int samples)
 {
+  /* SetTestSound holds the processor lock while it calls SetTestMode, take
+   * the locks in the same order */
+  CLockObject processorLock(g_DSPProcessor.m_Mutex);
   CLockObject lock(m_Mutex);
 
-  for (unsigned pos = 0; pos < samples; pos++)
+  if (m_currentTestMode == SOUND_TEST_OFF)
+  {
+    /* as cDSPProcessorStream::CopyInToOut, buffers shared in place are left alone */
+    for (unsigned int i = 0; i < m_Routing->iOutCount; ++i)
+    {
+      AE_DSP_CHANNEL channel = m_Routing->iOut[i];
+      if (array_out[channel] != array_in[channel])
+        memcpy(array_out[channel], array_in[channel], samples * sizeof(float));
+    }
+    return samples;
+  }
+
+  for (unsigned int i = 0; i < m_Routing->iOutCount; ++i)
+    memset(array_out[m_Routing->iOut[i]], 0, samples * sizeof(float));
+
+  if (m_currentTestMode == SOUND_TEST_SWEEP)
+  {
+    AE_DSP_CHANNEL channel = AE_DSP_CH_INVALID;
+    if (g_DSPProcessor.m_Calibration)
+      channel = g_DSPProcessor.m_Calibration->Process(array_out, samples, this);
+
+    if (channel != m_currentTestPointer)
+    {
+      m_currentTestPointer = channel;
+      if (m_currentTestContinues && channel != AE_DSP_CH_INVALID)
+        m_Prefetch->PostSwitchInfo(channel);
+    }
+    return samples;
+  }
+
+  if (m_currentTestPointer == AE_DSP_CH_INVALID)
+    return samples;
+
+  /* the block is split at the sample where the continues test moves on */
+  unsigned int pos = 0;
+  while (pos < samples)
   {
-    if (m_currentTestMode != SOUND_TEST_OFF)
+    unsigned int length = samples - pos;
+    if (m_currentTestContinues && m_SamplesToSwitch < length)
+      length = m_SamplesToSwitch;
+
+    if (m_Signal)
+    {
+      m_Signal->Generate(array_out[m_currentTestPointer] + pos, length);
+    }
+    else if (m_currentTestMode == SOUND_TEST_VOICE)
     {
-      array_out[AE_DSP_CH_FL][pos]   = 0;
-      array_out[AE_DSP_CH_FR][pos]   = 0;
-      array_out[AE_DSP_CH_FC][pos]   = 0;
-      array_out[AE_DSP_CH_LFE][pos]  = 0;
-      array_out[AE_DSP_CH_BL][pos]   = 0;
-      array_out[AE_DSP_CH_BR][pos]   = 0;
-      array_out[AE_DSP_CH_FLOC][pos] = 0;
-      array_out[AE_DSP_CH_FROC][pos] = 0;
-      array_out[AE_DSP_CH_BC][pos]   = 0;
-      array_out[AE_DSP_CH_SL][pos]   = 0;
-      array_out[AE_DSP_CH_SR][pos]   = 0;
-      array_out[AE_DSP_CH_TFL][pos]  = 0;
-      array_out[AE_DSP_CH_TFR][pos]  = 0;
-      array_out[AE_DSP_CH_TFC][pos]  = 0;
-      array_out[AE_DSP_CH_TC][pos]   = 0;
-      array_out[AE_DSP_CH_TBL][pos]  = 0;
-      array_out[AE_DSP_CH_TBR][pos]  = 0;
-      array_out[AE_DSP_CH_TBC][pos]  = 0;
-      array_out[AE_DSP_CH_BLOC][pos] = 0;
-      array_out[AE_DSP_CH_BROC][pos] = 0;
-
-      if (m_currentTestPointer != AE_DSP_CH_INVALID)
+      const std::vector<float> *clip = m_Prefetch->GetClip(m_currentTestPointer);
+      if (clip && m_ClipPosition < clip->size())
       {
-        if (m_currentTestMode == SOUND_TEST_PINK_NOICE)
-        {
-          if (m_currentTestContinues)
-          {
-            time_t Now = time(NULL);
-            if (Now - m_lastContinuesChange > CONTINUES_PINK_NOISE_TIME)
-            {
-              m_currentTestPointer = GetNextChannelPtr(m_currentTestPointer);
-              if (m_ContinueTestCBClass)
-                m_ContinueTestCBClass->ContinuesTestSwitchInfoCB(m_currentTestPointer);
-              m_lastContinuesChange = Now;
-            }
-          }
-          array_out[m_currentTestPointer][pos] = m_NoiseSource->getValue();
-        }
-        else if (m_currentTestMode == SOUND_TEST_VOICE)
-        {
-          if (m_currentTestContinues)
-          {
-            time_t Now = time(NULL);
-            if (Now - m_lastContinuesChange > CONTINUES_SOUND_TEST_TIME)
-            {
-              if (m_TestSound)
-                delete m_TestSound;
-
-              m_currentTestPointer = GetNextChannelPtr(m_currentTestPointer);
-              if (m_ContinueTestCBClass)
-                m_ContinueTestCBClass->ContinuesTestSwitchInfoCB(m_currentTestPointer);
-              m_TestSound = ADSP->GetSoundPlay(GetSoundFile(m_currentTestPointer).c_str());
-              m_TestSound->SetChannel(m_currentTestPointer);
-              m_TestSound->SetVolume(g_DSPProcessor.m_OutputGain[m_currentTestPointer]);
-              m_TestSound->Play();
-              m_lastContinuesChange = Now;
-            }
-          }
-        }
+        unsigned int count = clip->size() - m_ClipPosition;
+        if (count > length)
+          count = length;
+        memcpy(array_out[m_currentTestPointer] + pos, &(*clip)[m_ClipPosition], count * sizeof(float));
+        m_ClipPosition += count;
       }
     }
-    else
+    pos += length;
+
+    if (m_currentTestContinues)
     {
-      array_out[AE_DSP_CH_FL][pos]   = array_in[AE_DSP_CH_FL][pos];
-      array_out[AE_DSP_CH_FR][pos]   = array_in[AE_DSP_CH_FR][pos];
-      array_out[AE_DSP_CH_FC][pos]   = array_in[AE_DSP_CH_FC][pos];
-      array_out[AE_DSP_CH_LFE][pos]  = array_in[AE_DSP_CH_LFE][pos];
-      array_out[AE_DSP_CH_BL][pos]   = array_in[AE_DSP_CH_BL][pos];
-      array_out[AE_DSP_CH_BR][pos]   = array_in[AE_DSP_CH_BR][pos];
-      array_out[AE_DSP_CH_FLOC][pos] = array_in[AE_DSP_CH_FLOC][pos];
-      array_out[AE_DSP_CH_FROC][pos] = array_in[AE_DSP_CH_FROC][pos];
-      array_out[AE_DSP_CH_BC][pos]   = array_in[AE_DSP_CH_BC][pos];
-      array_out[AE_DSP_CH_SL][pos]   = array_in[AE_DSP_CH_SL][pos];
-      array_out[AE_DSP_CH_SR][pos]   = array_in[AE_DSP_CH_SR][pos];
-      array_out[AE_DSP_CH_TFL][pos]  = array_in[AE_DSP_CH_TFL][pos];
-      array_out[AE_DSP_CH_TFR][pos]  = array_in[AE_DSP_CH_TFR][pos];
-      array_out[AE_DSP_CH_TFC][pos]  = array_in[AE_DSP_CH_TFC][pos];
-      array_out[AE_DSP_CH_TC][pos]   = array_in[AE_DSP_CH_TC][pos];
-      array_out[AE_DSP_CH_TBL][pos]  = array_in[AE_DSP_CH_TBL][pos];
-      array_out[AE_DSP_CH_TBR][pos]  = array_in[AE_DSP_CH_TBR][pos];
-      array_out[AE_DSP_CH_TBC][pos]  = array_in[AE_DSP_CH_TBC][pos];
-      array_out[AE_DSP_CH_BLOC][pos] = array_in[AE_DSP_CH_BLOC][pos];
-      array_out[AE_DSP_CH_BROC][pos] = array_in[AE_DSP_CH_BROC][pos];
+      m_SamplesToSwitch -= length;
+      if (m_SamplesToSwitch == 0)
+        SwitchChannel(GetNextChannelPtr(m_currentTestPointer));
     }
   }
   return samples;
 }
 
+int cDSPProcessorSoundTest::GetTestSignal(int mode)
+{
+  switch (mode)
+  {
+  case SOUND_TEST_PINK_NOICE:
+    return TEST_SIGNAL_PINK_NOISE;
+  case SOUND_TEST_PINK_NOISE_BAND:
+    return TEST_SIGNAL_PINK_NOISE_BAND;
+  case SOUND_TEST_SINE:
+    return TEST_SIGNAL_SINE;
+  case SOUND_TEST_LOG_SWEEP:
+    return TEST_SIGNAL_LOG_SWEEP;
+  case SOUND_TEST_IMPULSE:
+    return TEST_SIGNAL_IMPULSE;
+  case SOUND_TEST_CHIRP:
+    return TEST_SIGNAL_CHIRP;
+  case SOUND_TEST_PINK_NOISE_FILTER:
+    return TEST_SIGNAL_PINK_NOISE_FILTER;
+  default:
+    return -1;
+  }
+}
+
 AE_DSP_CHANNEL cDSPProcessorSoundTest::GetNextChannelPtr(AE_DSP_CHANNEL previous)
 {
   AE_DSP_CHANNEL next = AE_DSP_CH_FL;
@@ -307,3 +323,139 @@ AE_DSP_CHANNEL cDSPProcessorSoundTest::GetNextChannelPtr(AE_DSP_CHANNEL previous
   }
   return next;
 }
+
+cDSPTestClipCache::cDSPTestClipCache()
+{
+}
+
+cDSPTestClipCache::~cDSPTestClipCache()
+{
+  for (std::map<std::string, std::vector<float>*>::iterator it = m_Clips.begin(); it != m_Clips.end(); ++it)
+    delete it->second;
+}
+
+const std::vector<float> *cDSPTestClipCache::GetClip(const std::string &file, unsigned int samplingRate)
+{
+  char key[16];
+  snprintf(key, sizeof(key), "@%u", samplingRate);
+  std::string name = file + key;
+
+  {
+    CLockObject lock(m_Mutex);
+    std::map<std::string, std::vector<float>*>::iterator it = m_Clips.find(name);
+    if (it != m_Clips.end())
+      return it->second;
+  }
+
+  std::vector<float> data;
+  unsigned int fileRate;
+  if (!cDSPCalibration::LoadWaveFile(file, data, fileRate) || data.empty())
+  {
+    KODI->Log(LOG_ERROR, "%s - Failed to load test clip '%s'", __FUNCTION__, file.c_str());
+    return NULL;
+  }
+
+  /* linear interpolation to the rate of the stream, done once per clip */
+  std::vector<float> *clip = new std::vector<float>;
+  if (fileRate == samplingRate)
+  {
+    clip->swap(data);
+  }
+  else
+  {
+    double step = (double)fileRate / samplingRate;
+    clip->resize((size_t)((data.size() - 1) / step) + 1);
+    for (size_t i = 0; i < clip->size(); ++i)
+    {
+      double source = i * step;
+      size_t index  = (size_t)source;
+      float frac    = (float)(source - index);
+      float next    = index + 1 < data.size() ? data[index + 1] : data[index];
+      (*clip)[i]    = data[index] + (next - data[index]) * frac;
+    }
+  }
+
+  CLockObject lock(m_Mutex);
+  std::pair<std::map<std::string, std::vector<float>*>::iterator, bool> result = m_Clips.insert(std::make_pair(name, clip));
+  if (!result.second)
+    delete clip;
+  return result.first->second;
+}
+
+static cDSPTestClipCache g_TestClipCache;
+
+cDSPSoundTestPrefetch::cDSPSoundTestPrefetch(unsigned int samplingRate, CGUIDialogSpeakerGain *cbClass)
+  : m_SamplingRate(samplingRate)
+  , m_ContinueTestCBClass(cbClass)
+  , m_PostedPrefetch(0)
+  , m_PostedSwitchInfo(AE_DSP_CH_INVALID)
+{
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+    m_Ready[i] = NULL;
+}
+
+cDSPSoundTestPrefetch::~cDSPSoundTestPrefetch()
+{
+  StopThread(-1);
+  m_Event.Signal();
+  StopThread();
+}
+
+void cDSPSoundTestPrefetch::PostPrefetch(unsigned long channelFlags)
+{
+  {
+    CLockObject lock(m_Mutex);
+    m_PostedPrefetch |= channelFlags;
+  }
+  m_Event.Signal();
+}
+
+void cDSPSoundTestPrefetch::PostSwitchInfo(AE_DSP_CHANNEL channel)
+{
+  {
+    CLockObject lock(m_Mutex);
+    m_PostedSwitchInfo = channel;
+  }
+  m_Event.Signal();
+}
+
+const std::vector<float> *cDSPSoundTestPrefetch::GetClip(AE_DSP_CHANNEL channel)
+{
+  CLockObject lock(m_Mutex);
+  return m_Ready[channel];
+}
+
+void *cDSPSoundTestPrefetch::Process(void)
+{
+  while (!IsStopped())
+  {
+    m_Event.Wait();
+    if (IsStopped())
+      break;
+
+    unsigned long prefetch;
+    AE_DSP_CHANNEL switchInfo;
+    {
+      CLockObject lock(m_Mutex);
+      prefetch            = m_PostedPrefetch;
+      switchInfo          = m_PostedSwitchInfo;
+      m_PostedPrefetch    = 0;
+      m_PostedSwitchInfo  = AE_DSP_CH_INVALID;
+    }
+
+    if (switchInfo != AE_DSP_CH_INVALID && m_ContinueTestCBClass)
+      m_ContinueTestCBClass->ContinuesTestSwitchInfoCB(switchInfo);
+
+    for (int i = 0; i < AE_DSP_CH_MAX && !IsStopped(); ++i)
+    {
+      if (!(prefetch & (1 << i)) || GetClip((AE_DSP_CHANNEL)i))
+        continue;
+
+      const std::vector<float> *clip = g_TestClipCache.GetClip(GetSoundFile((AE_DSP_CHANNEL)i), m_SamplingRate);
+
+      CLockObject lock(m_Mutex);
+      m_Ready[i] = clip;
+    }
+  }
+  return NULL;
+}
@@ -18,39 +18,114 @@
  *
  */
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include "p8-platform/threads/threads.h"
 #include "p8-platform/threads/mutex.h"
 
 #define SOUND_TEST_OFF              0
 #define SOUND_TEST_PINK_NOICE       1
 #define SOUND_TEST_VOICE            2
+#define SOUND_TEST_SWEEP            3   //!< Calibration sweep, see cDSPCalibration
+#define SOUND_TEST_PINK_NOISE_BAND  4   //!< Signals of cDSPTestSignal
+#define SOUND_TEST_SINE             5
+#define SOUND_TEST_LOG_SWEEP        6
+#define SOUND_TEST_IMPULSE          7
+#define SOUND_TEST_CHIRP            8
+#define SOUND_TEST_PINK_NOISE_FILTER 9
 
-#define CONTINUES_PINK_NOISE_TIME   2
-#define CONTINUES_SOUND_TEST_TIME   2
+#define CONTINUES_PINK_NOISE_TIME   3   //!< Seconds per channel
+#define CONTINUES_SOUND_TEST_TIME   3   //!< Seconds per channel
 
-class cPinkNoise;
+class cDSPTestSignal;
 class CGUIDialogSpeakerGain;
+struct sChannelRouting;
+
+/*
+ * Decoded voice clips, shared by all streams of the add-on.
+ *
+ * Every clip is decoded once per sample rate into raw float PCM and kept
+ * until the add-on is unloaded, so the pointers handed out stay valid.
+ */
+class cDSPTestClipCache
+{
+public:
+  cDSPTestClipCache();
+  ~cDSPTestClipCache();
+
+  /*!
+   * Decode the clip on first use, must not be called from the audio thread
+   */
+  const std::vector<float> *GetClip(const std::string &file, unsigned int samplingRate);
+
+private:
+  P8PLATFORM::CMutex                          m_Mutex;
+  std::map<std::string, std::vector<float>*>  m_Clips;
+};
+
+/*
+ * Host calls of the sound test, run outside of the audio thread.
+ *
+ * The voice clips of the requested channels are decoded ahead of time into
+ * the ready table, the audio thread mixes them itself. Dialog updates of the
+ * continues test are done here as well. The thread sleeps on an event until
+ * a request is posted.
+ */
+class cDSPSoundTestPrefetch : public P8PLATFORM::CThread
+{
+public:
+  cDSPSoundTestPrefetch(unsigned int samplingRate, CGUIDialogSpeakerGain *cbClass);
+  virtual ~cDSPSoundTestPrefetch();
+
+  void PostPrefetch(unsigned long channelFlags);
+  void PostSwitchInfo(AE_DSP_CHANNEL channel);
+
+  /*!
+   * Decoded clip of the channel or NULL if not ready yet, used by the audio thread
+   */
+  const std::vector<float> *GetClip(AE_DSP_CHANNEL channel);
+
+  virtual void *Process(void);
+
+private:
+  unsigned int              m_SamplingRate;
+  CGUIDialogSpeakerGain    *m_ContinueTestCBClass;
+
+  P8PLATFORM::CMutex        m_Mutex;          //!< Protects the posted requests and the ready table
+  const std::vector<float> *m_Ready[AE_DSP_CH_MAX];
+  unsigned long             m_PostedPrefetch;
+  AE_DSP_CHANNEL            m_PostedSwitchInfo;
+  P8PLATFORM::CEvent        m_Event;          //!< Signaled on every posted request
+};
 
 class cDSPProcessorSoundTest
 {
 public:
-  cDSPProcessorSoundTest(unsigned long outChannelPresentFlags, CGUIDialogSpeakerGain *cbClass);
+  cDSPProcessorSoundTest(const sChannelRouting *routing, unsigned long outChannelPresentFlags, unsigned int samplingRate, CGUIDialogSpeakerGain *cbClass);
   ~cDSPProcessorSoundTest();
 
   void SetTestMode(int mode, AE_DSP_CHANNEL channel, bool continues);
-  void SetTestVolume(float volume);
+  int GetTestMode() const { return m_currentTestMode; }
   unsigned int ProcessTestMode(float **array_in, float **array_out, unsigned int samples);
 
 private:
   AE_DSP_CHANNEL GetNextChannelPtr(AE_DSP_CHANNEL previous);
+  static int GetTestSignal(int mode);
+  unsigned int GetContinuesPeriod() const;
+  void SwitchChannel(AE_DSP_CHANNEL channel);
 
   AE_DSP_CHANNEL    m_currentTestPointer;
   int               m_currentTestMode;
   bool              m_currentTestContinues;
-  time_t            m_lastContinuesChange;
+  unsigned int      m_SamplesToSwitch;    //!< Samples left on the current channel of the continues test
+  const sChannelRouting *m_Routing;
   unsigned long     m_OutChannelPresentFlags;
-  cPinkNoise       *m_NoiseSource;
-  CAddonSoundPlay  *m_TestSound;
+  unsigned int      m_SamplingRate;
+  cDSPTestSignal   *m_Signal;
+  unsigned int      m_ClipPosition;       //!< Samples of the voice clip already played
+  cDSPSoundTestPrefetch *m_Prefetch;
   P8PLATFORM::CMutex  m_Mutex;
   CGUIDialogSpeakerGain *m_ContinueTestCBClass;
 };
@@ -0,0 +1,256 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "AudioDSPTestSignal.h"
+#include "filter/mkfilter.h"
+#include "filter/filter.h"
+
+#if !defined(M_PI) && defined(TARGET_WINDOWS)
+  #define _USE_MATH_DEFINES
+  #include <cmath>
+#endif
+
+#define TEST_SIGNAL_CHIRP_START         200.0     //!< Hz
+#define TEST_SIGNAL_CHIRP_END           8000.0    //!< Hz
+#define TEST_SIGNAL_LFE_CHIRP_START     20.0      //!< Hz
+#define TEST_SIGNAL_LFE_CHIRP_END       120.0     //!< Hz
+#define TEST_SIGNAL_SWEEP_FADE          0.01      //!< Seconds of fade out at the sweep end
+
+cDSPTestSignal::cDSPTestSignal(unsigned int samplingRate)
+  : m_SamplingRate(samplingRate)
+  , m_Signal(TEST_SIGNAL_PINK_NOISE)
+  , m_LowFrequency(false)
+  , m_Phase(0.0)
+  , m_Frequency(0.0)
+  , m_SweepFactor(1.0)
+  , m_SweepStart(0.0)
+  , m_SweepEnd(0.0)
+  , m_Position(0)
+  , m_Period(1)
+  , m_Length(0)
+{
+  m_BandPass[0] = NULL;
+  m_BandPass[1] = NULL;
+}
+
+cDSPTestSignal::~cDSPTestSignal()
+{
+  delete m_BandPass[0];
+  delete m_BandPass[1];
+}
+
+void cDSPTestSignal::SetSignal(int signal, AE_DSP_CHANNEL channel)
+{
+  m_Signal = signal;
+  m_NoiseSource.setMethod(signal == TEST_SIGNAL_PINK_NOISE_FILTER ? PINK_NOISE_KELLET : PINK_NOISE_VOSS_MCCARTNEY);
+
+  if (signal == TEST_SIGNAL_PINK_NOISE_BAND)
+  {
+    /* both variants at once, the continues test only switches between them */
+    for (int lowFrequency = 0; lowFrequency < 2; ++lowFrequency)
+    {
+      int numzero;
+      int numpole;
+      double xcoeffs[MAXPZ+1];
+      double ycoeffs[MAXPZ+1];
+      double gain;
+
+      double low  = lowFrequency ? TEST_SIGNAL_LFE_BAND_LOW : TEST_SIGNAL_BAND_LOW;
+      double high = lowFrequency ? TEST_SIGNAL_LFE_BAND_HIGH : TEST_SIGNAL_BAND_HIGH;
+      mkfilter(BUTTERWORTH, BAND_PASS, 2, low / m_SamplingRate, high / m_SamplingRate, 0.0,
+               &numzero, xcoeffs, &numpole, ycoeffs, &gain, 0.0);
+
+      if (m_BandPass[lowFrequency] == NULL)
+        m_BandPass[lowFrequency] = new Cfilter;
+      m_BandPass[lowFrequency]->Config(numzero, xcoeffs, numpole, ycoeffs, gain);
+    }
+  }
+
+  SetChannel(channel);
+}
+
+void cDSPTestSignal::SetChannel(AE_DSP_CHANNEL channel)
+{
+  m_LowFrequency  = channel == AE_DSP_CH_LFE;
+  m_Phase         = 0.0;
+  m_Position      = 0;
+
+  double nyquistLimit = 0.45 * m_SamplingRate;
+
+  switch (m_Signal)
+  {
+  case TEST_SIGNAL_PINK_NOISE_BAND:
+    m_BandPass[m_LowFrequency]->Flush();
+    break;
+  case TEST_SIGNAL_LOG_SWEEP:
+    m_SweepStart  = TEST_SIGNAL_SWEEP_START;
+    m_SweepEnd    = m_LowFrequency ? TEST_SIGNAL_LFE_SWEEP_END : TEST_SIGNAL_SWEEP_END;
+    if (m_SweepEnd > nyquistLimit)
+      m_SweepEnd = nyquistLimit;
+    m_Length      = (unsigned int)(TEST_SIGNAL_SWEEP_TIME * m_SamplingRate);
+    m_Period      = m_Length + (unsigned int)(TEST_SIGNAL_SWEEP_GAP * m_SamplingRate);
+    m_SweepFactor = exp(log(m_SweepEnd / m_SweepStart) / m_Length);
+    m_Frequency   = m_SweepStart;
+    break;
+  case TEST_SIGNAL_IMPULSE:
+    m_Period      = (unsigned int)(TEST_SIGNAL_PULSE_PERIOD * m_SamplingRate);
+    m_Length      = 1;
+    break;
+  case TEST_SIGNAL_CHIRP:
+    m_SweepStart  = m_LowFrequency ? TEST_SIGNAL_LFE_CHIRP_START : TEST_SIGNAL_CHIRP_START;
+    m_SweepEnd    = m_LowFrequency ? TEST_SIGNAL_LFE_CHIRP_END : TEST_SIGNAL_CHIRP_END;
+    if (m_SweepEnd > nyquistLimit)
+      m_SweepEnd = nyquistLimit;
+    m_Length      = (unsigned int)((m_LowFrequency ? TEST_SIGNAL_LFE_CHIRP_TIME : TEST_SIGNAL_CHIRP_TIME) * m_SamplingRate);
+    m_Period      = (unsigned int)(TEST_SIGNAL_PULSE_PERIOD * m_SamplingRate);
+    break;
+  case TEST_SIGNAL_SINE:
+    m_Frequency   = m_LowFrequency ? TEST_SIGNAL_LFE_SINE_FREQ : TEST_SIGNAL_SINE_FREQ;
+    break;
+  case TEST_SIGNAL_PINK_NOISE:
+  case TEST_SIGNAL_PINK_NOISE_FILTER:
+  default:
+    break;
+  }
+}
+
+unsigned int cDSPTestSignal::GetPeriod() const
+{
+  if (m_Signal == TEST_SIGNAL_LOG_SWEEP || m_Signal == TEST_SIGNAL_IMPULSE || m_Signal == TEST_SIGNAL_CHIRP)
+    return m_Period;
+  return 0;
+}
+
+void cDSPTestSignal::Generate(float *out, unsigned int samples)
+{
+  switch (m_Signal)
+  {
+  case TEST_SIGNAL_PINK_NOISE_BAND:
+    GenerateBandNoise(out, samples);
+    break;
+  case TEST_SIGNAL_SINE:
+    GenerateSine(out, samples);
+    break;
+  case TEST_SIGNAL_LOG_SWEEP:
+    GenerateSweep(out, samples);
+    break;
+  case TEST_SIGNAL_IMPULSE:
+    GenerateImpulse(out, samples);
+    break;
+  case TEST_SIGNAL_CHIRP:
+    GenerateChirp(out, samples);
+    break;
+  case TEST_SIGNAL_PINK_NOISE:
+  case TEST_SIGNAL_PINK_NOISE_FILTER:
+  default:
+    m_NoiseSource.Generate(out, samples);
+    break;
+  }
+}
+
+void cDSPTestSignal::GenerateBandNoise(float *out, unsigned int samples)
+{
+  m_NoiseSource.Generate(out, samples);
+
+  Cfilter *bandPass = m_BandPass[m_LowFrequency];
+  for (unsigned int pos = 0; pos < samples; ++pos)
+    out[pos] = TEST_SIGNAL_BAND_GAIN * (float)bandPass->GetNext(out[pos]);
+}
+
+void cDSPTestSignal::GenerateSine(float *out, unsigned int samples)
+{
+  double increment = 2.0 * M_PI * m_Frequency / m_SamplingRate;
+  double phase     = m_Phase;
+  for (unsigned int pos = 0; pos < samples; ++pos)
+  {
+    out[pos] = TEST_SIGNAL_LEVEL * (float)sin(phase);
+    phase += increment;
+  }
+  m_Phase = fmod(phase, 2.0 * M_PI);
+}
+
+void cDSPTestSignal::GenerateSweep(float *out, unsigned int samples)
+{
+  const double       scale = 2.0 * M_PI / m_SamplingRate;
+  const unsigned int fade  = (unsigned int)(TEST_SIGNAL_SWEEP_FADE * m_SamplingRate);
+
+  for (unsigned int pos = 0; pos < samples; ++pos)
+  {
+    if (m_Position < m_Length)
+    {
+      float level = TEST_SIGNAL_LEVEL;
+      if (m_Position + fade > m_Length)
+        level *= (float)(m_Length - m_Position) / fade;
+
+      out[pos]     = level * (float)sin(m_Phase);
+      m_Phase     += scale * m_Frequency;
+      m_Frequency *= m_SweepFactor;
+    }
+    else
+    {
+      out[pos] = 0.0f;
+    }
+
+    if (++m_Position >= m_Period)
+    {
+      m_Position  = 0;
+      m_Phase     = 0.0;
+      m_Frequency = m_SweepStart;
+    }
+  }
+}
+
+void cDSPTestSignal::GenerateImpulse(float *out, unsigned int samples)
+{
+  memset(out, 0, samples * sizeof(float));
+
+  unsigned int pos = m_Position == 0 ? 0 : m_Period - m_Position;
+  for (; pos < samples; pos += m_Period)
+    out[pos] = TEST_SIGNAL_PULSE_LEVEL;
+
+  m_Position = (m_Position + samples) % m_Period;
+}
+
+void cDSPTestSignal::GenerateChirp(float *out, unsigned int samples)
+{
+  /* linear chirp with a Hann window, starting on a positive half wave so
+   * a reversed polarity is visible on the measurement */
+  const double duration = (double)m_Length / m_SamplingRate;
+  const double sweep    = (m_SweepEnd - m_SweepStart) / (2.0 * duration);
+
+  for (unsigned int pos = 0; pos < samples; ++pos)
+  {
+    if (m_Position < m_Length)
+    {
+      double t      = (double)m_Position / m_SamplingRate;
+      double window = 0.5 - 0.5 * cos(2.0 * M_PI * m_Position / m_Length);
+      out[pos] = TEST_SIGNAL_PULSE_LEVEL * (float)(window * sin(2.0 * M_PI * (m_SweepStart + sweep * t) * t));
+    }
+    else
+    {
+      out[pos] = 0.0f;
+    }
+
+    if (++m_Position >= m_Period)
+      m_Position = 0;
+  }
+}
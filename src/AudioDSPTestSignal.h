@@ -0,0 +1,111 @@
+#pragma once
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Test signal generator of the sound test.
+ *
+ * All signals are created block wise into a single buffer which the sound
+ * test then places on the channel under test. The LFE channel gets the
+ * low frequency variant of the band limited signals.
+ */
+
+#include "kodi_adsp_types.h"
+#include "PinkNoise.h"
+#include "filter/precision.h"
+
+#define TEST_SIGNAL_PINK_NOISE          0
+#define TEST_SIGNAL_PINK_NOISE_BAND     1   //!< Pink noise limited to the reference band
+#define TEST_SIGNAL_SINE                2
+#define TEST_SIGNAL_LOG_SWEEP           3
+#define TEST_SIGNAL_IMPULSE             4
+#define TEST_SIGNAL_CHIRP               5   //!< Windowed chirp for polarity and phase checks
+#define TEST_SIGNAL_PINK_NOISE_FILTER   6   //!< Pink noise of Paul Kellet's filter bank
+
+#define TEST_SIGNAL_LEVEL               0.177f    //!< Sine peak, -18 dBFS RMS as the pink noise
+#define TEST_SIGNAL_PULSE_LEVEL         0.5f      //!< Peak of impulse and chirp
+#define TEST_SIGNAL_BAND_LOW            500.0     //!< Hz, reference band of the speakers
+#define TEST_SIGNAL_BAND_HIGH           2000.0    //!< Hz
+#define TEST_SIGNAL_BAND_GAIN           3.8f      //!< Brings the two octave band to the level of the full range noise
+#define TEST_SIGNAL_LFE_BAND_LOW        30.0      //!< Hz, reference band of the LFE
+#define TEST_SIGNAL_LFE_BAND_HIGH       120.0     //!< Hz
+#define TEST_SIGNAL_SINE_FREQ           1000.0    //!< Hz
+#define TEST_SIGNAL_LFE_SINE_FREQ       50.0      //!< Hz
+#define TEST_SIGNAL_SWEEP_START         20.0      //!< Hz
+#define TEST_SIGNAL_SWEEP_END           20000.0   //!< Hz, limited to 0.45 of the sample rate
+#define TEST_SIGNAL_LFE_SWEEP_END       200.0     //!< Hz
+#define TEST_SIGNAL_SWEEP_TIME          5.0       //!< Seconds
+#define TEST_SIGNAL_SWEEP_GAP           0.5       //!< Seconds of silence between the sweeps
+#define TEST_SIGNAL_PULSE_PERIOD        1.0       //!< Seconds between impulses and chirps
+#define TEST_SIGNAL_CHIRP_TIME          0.05      //!< Seconds
+#define TEST_SIGNAL_LFE_CHIRP_TIME      0.2       //!< Seconds
+
+
+class cDSPTestSignal
+{
+public:
+  cDSPTestSignal(unsigned int samplingRate);
+  ~cDSPTestSignal();
+
+  /*!
+   * Select the signal, the channel decides between full range and LFE variant.
+   * The filters of both variants are designed here, not usable on the audio thread
+   */
+  void SetSignal(int signal, AE_DSP_CHANNEL channel);
+  int GetSignal() const { return m_Signal; }
+
+  /*!
+   * Restart the selected signal for another channel, does not allocate and
+   * is used by the continues test on the audio thread
+   */
+  void SetChannel(AE_DSP_CHANNEL channel);
+
+  /*!
+   * Samples until a repeated signal starts again, 0 for continuous signals
+   */
+  unsigned int GetPeriod() const;
+
+  /*!
+   * Fill the given buffer with the next block of the signal
+   */
+  void Generate(float *out, unsigned int samples);
+
+private:
+  void GenerateBandNoise(float *out, unsigned int samples);
+  void GenerateSine(float *out, unsigned int samples);
+  void GenerateSweep(float *out, unsigned int samples);
+  void GenerateImpulse(float *out, unsigned int samples);
+  void GenerateChirp(float *out, unsigned int samples);
+
+  unsigned int    m_SamplingRate;
+  int             m_Signal;
+  bool            m_LowFrequency;
+
+  cPinkNoise      m_NoiseSource;
+  Cfilter        *m_BandPass[2];    //!< Reference band of full range and LFE, indexed by m_LowFrequency
+
+  double          m_Phase;          //!< Radians of sine and sweep
+  double          m_Frequency;      //!< Current sweep frequency in Hz
+  double          m_SweepFactor;    //!< Per sample frequency growth of the sweep
+  double          m_SweepStart;
+  double          m_SweepEnd;
+  unsigned int    m_Position;       //!< Samples inside the current period
+  unsigned int    m_Period;         //!< Samples of sweep, impulse or chirp period
+  unsigned int    m_Length;         //!< Samples of the active part inside the period
+};
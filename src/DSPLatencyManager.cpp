@@ -0,0 +1,81 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include <string.h>
+
+#include "DSPLatencyManager.h"
+
+CDSPLatencyManager::CDSPLatencyManager()
+{
+  Reset();
+}
+
+void CDSPLatencyManager::Reset()
+{
+  memset(m_Latency, 0, sizeof(m_Latency));
+}
+
+void CDSPLatencyManager::SetStageLatency(eLatencyStage stage, AE_DSP_CHANNEL channel, unsigned int samples)
+{
+  if (stage < LATENCY_STAGE_MAX && channel > AE_DSP_CH_INVALID && channel < AE_DSP_CH_MAX)
+    m_Latency[stage][channel] = samples;
+}
+
+void CDSPLatencyManager::SetStageLatency(eLatencyStage stage, unsigned long channelPresentFlags, unsigned int samples)
+{
+  if (stage >= LATENCY_STAGE_MAX)
+    return;
+
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+    m_Latency[stage][i] = (channelPresentFlags & (1 << i)) ? samples : 0;
+}
+
+unsigned int CDSPLatencyManager::GetChannelLatency(AE_DSP_CHANNEL channel) const
+{
+  if (channel <= AE_DSP_CH_INVALID || channel >= AE_DSP_CH_MAX)
+    return 0;
+
+  unsigned int latency = 0;
+  for (int stage = 0; stage < LATENCY_STAGE_MAX; ++stage)
+    latency += m_Latency[stage][channel];
+  return latency;
+}
+
+unsigned int CDSPLatencyManager::GetTotalLatency(unsigned long channelPresentFlags) const
+{
+  unsigned int total = 0;
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    if (!(channelPresentFlags & (1 << i)))
+      continue;
+
+    unsigned int latency = GetChannelLatency((AE_DSP_CHANNEL)i);
+    if (latency > total)
+      total = latency;
+  }
+  return total;
+}
+
+unsigned int CDSPLatencyManager::GetPadding(AE_DSP_CHANNEL channel, unsigned long channelPresentFlags) const
+{
+  if (channel <= AE_DSP_CH_INVALID || channel >= AE_DSP_CH_MAX || !(channelPresentFlags & (1 << channel)))
+    return 0;
+
+  return GetTotalLatency(channelPresentFlags) - GetChannelLatency(channel);
+}
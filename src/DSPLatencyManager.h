@@ -0,0 +1,73 @@
+#pragma once
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Latency of the post process stages per output channel.
+ *
+ * Every stage which holds the signal back reports its samples here. The
+ * channels are padded up to the largest sum in the speaker delay line, so
+ * the speaker correction stays the only difference between the channels
+ * and the stream is reported with the latency it really has.
+ *
+ * The limiter look-ahead is the only stage so far and it is the same on
+ * every channel, so no channel is padded yet. The speaker delay is the
+ * correction itself and is not a stage, the dialogue enhancer adds its
+ * filtered speech band onto the undelayed center and holds nothing back.
+ */
+
+#include "kodi_adsp_types.h"
+
+typedef enum
+{
+  LATENCY_STAGE_LIMITER = 0,      //!< Look-ahead of the compressor and limiter
+  LATENCY_STAGE_MAX
+} eLatencyStage;
+
+class CDSPLatencyManager
+{
+public:
+  CDSPLatencyManager();
+
+  void Reset();
+
+  /*!
+   * Samples a stage holds back on one channel or on all present channels
+   */
+  void SetStageLatency(eLatencyStage stage, AE_DSP_CHANNEL channel, unsigned int samples);
+  void SetStageLatency(eLatencyStage stage, unsigned long channelPresentFlags, unsigned int samples);
+
+  /*!
+   * Sum of the stages on the channel
+   */
+  unsigned int GetChannelLatency(AE_DSP_CHANNEL channel) const;
+
+  /*!
+   * Largest sum over the present channels, all channels are padded up to it
+   */
+  unsigned int GetTotalLatency(unsigned long channelPresentFlags) const;
+
+  /*!
+   * Samples the delay line of the channel has to add to reach the total
+   */
+  unsigned int GetPadding(AE_DSP_CHANNEL channel, unsigned long channelPresentFlags) const;
+
+private:
+  unsigned int m_Latency[LATENCY_STAGE_MAX][AE_DSP_CH_MAX];
+};
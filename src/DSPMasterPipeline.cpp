@@ -0,0 +1,250 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include <string.h>
+
+#include "DSPMasterPipeline.h"
+#include "DSPProcessMaster.h"
+#include "filter/denormal.h"
+
+using namespace std;
+
+CDSPMasterPipeline::CDSPMasterPipeline(CDSPProcessMaster *mode)
+  : m_Mode(mode)
+  , m_InChannelPresentFlags(0)
+  , m_OutChannelPresentFlags(0)
+  , m_SamplingRate(0)
+  , m_BlockSize(0)
+  , m_Latency(0)
+  , m_PollInterval(1)
+  , m_Written(0)
+  , m_Processed(0)
+  , m_Read(0)
+  , m_ReadOffset(0)
+  , m_Silence(0)
+  , m_Skip(0)
+{
+  memset(m_Blocks, 0, sizeof(m_Blocks));
+}
+
+CDSPMasterPipeline::~CDSPMasterPipeline()
+{
+  StopThread();
+}
+
+bool CDSPMasterPipeline::Initialize(const AE_DSP_SETTINGS *settings)
+{
+  m_InChannelPresentFlags   = settings->lInChannelPresentFlags;
+  m_OutChannelPresentFlags  = settings->lOutChannelPresentFlags;
+  m_SamplingRate            = settings->iProcessSamplerate;
+  m_BlockSize               = settings->iProcessFrames;
+  m_Latency                 = MASTER_PIPELINE_LATENCY * m_BlockSize;
+  if (m_BlockSize == 0 || m_SamplingRate == 0)
+    return false;
+
+  m_PollInterval = 1000 * m_BlockSize / (m_SamplingRate * MASTER_PIPELINE_POLL_SHARE);
+  if (m_PollInterval == 0)
+    m_PollInterval = 1;
+
+  /* every slot owns the present channels, absent channels share a cleared
+   * input and a discarded output buffer, the modes may touch all of them */
+  unsigned int buffers = 2;
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    if (m_InChannelPresentFlags & (1 << i))
+      ++buffers;
+    if (m_OutChannelPresentFlags & (1 << i))
+      ++buffers;
+  }
+  m_Memory.assign(MASTER_PIPELINE_SLOTS * buffers * m_BlockSize, 0.0f);
+
+  float *memory = &m_Memory[0];
+  for (unsigned int slot = 0; slot < MASTER_PIPELINE_SLOTS; ++slot)
+  {
+    float *absentIn  = memory; memory += m_BlockSize;
+    float *absentOut = memory; memory += m_BlockSize;
+
+    sBlock &block = m_Blocks[slot];
+    block.samples = 0;
+    for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+    {
+      if (m_InChannelPresentFlags & (1 << i))
+      {
+        block.in[i] = memory;
+        memory += m_BlockSize;
+      }
+      else
+        block.in[i] = absentIn;
+
+      if (m_OutChannelPresentFlags & (1 << i))
+      {
+        block.out[i] = memory;
+        memory += m_BlockSize;
+      }
+      else
+        block.out[i] = absentOut;
+    }
+  }
+
+  m_Written   = 0;
+  m_Processed = 0;
+  m_Read      = 0;
+  m_ReadOffset= 0;
+  m_Silence   = m_Latency;
+  m_Skip      = 0;
+
+  return CreateThread();
+}
+
+float CDSPMasterPipeline::GetDelay() const
+{
+  if (m_SamplingRate == 0)
+    return 0.0f;
+  return (float)m_Latency / m_SamplingRate;
+}
+
+unsigned int CDSPMasterPipeline::ProcessBlock(float **array_in, float **array_out, unsigned int samples)
+{
+  /* calls larger as a slot are passed on in parts */
+  if (samples > m_BlockSize)
+  {
+    float *in[AE_DSP_CH_MAX];
+    float *out[AE_DSP_CH_MAX];
+    for (unsigned int pos = 0; pos < samples; pos += m_BlockSize)
+    {
+      for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+      {
+        in[i]  = array_in[i]  ? array_in[i]  + pos : NULL;
+        out[i] = array_out[i] ? array_out[i] + pos : NULL;
+      }
+      ProcessBlock(in, out, samples - pos < m_BlockSize ? samples - pos : m_BlockSize);
+    }
+    return samples;
+  }
+
+  unsigned int written = m_Written.load(memory_order_relaxed);
+  if (written - m_Read < MASTER_PIPELINE_SLOTS)
+  {
+    sBlock &block = m_Blocks[written % MASTER_PIPELINE_SLOTS];
+    for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+    {
+      if (m_InChannelPresentFlags & (1 << i))
+        memcpy(block.in[i], array_in[i], samples * sizeof(float));
+    }
+    block.samples = samples;
+    m_Written.store(written + 1, memory_order_release);
+  }
+  else
+  {
+    /* worker too far behind, the block is dropped. Samples already muted by
+     * an underrun stand in for it, the rest is muted later so the latency
+     * keeps its value */
+    unsigned int skip = m_Skip < samples ? m_Skip : samples;
+    m_Skip    -= skip;
+    m_Silence += samples - skip;
+  }
+
+  /* return the processed stream m_Latency samples behind */
+  unsigned int pos = 0;
+  if (m_Silence > 0)
+  {
+    pos = m_Silence < samples ? m_Silence : samples;
+    for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+    {
+      if (m_OutChannelPresentFlags & (1 << i))
+        memset(array_out[i], 0, pos * sizeof(float));
+    }
+    m_Silence -= pos;
+  }
+
+  while (pos < samples)
+  {
+    if (m_Read == m_Processed.load(memory_order_acquire))
+    {
+      /* underrun, the missing part is muted and dropped when it arrives */
+      for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+      {
+        if (m_OutChannelPresentFlags & (1 << i))
+          memset(array_out[i] + pos, 0, (samples - pos) * sizeof(float));
+      }
+      m_Skip += samples - pos;
+      break;
+    }
+
+    const sBlock &ready = m_Blocks[m_Read % MASTER_PIPELINE_SLOTS];
+    unsigned int available = ready.samples - m_ReadOffset;
+    if (m_Skip > 0)
+    {
+      unsigned int skip = m_Skip < available ? m_Skip : available;
+      m_Skip       -= skip;
+      m_ReadOffset += skip;
+      available    -= skip;
+    }
+
+    unsigned int count = samples - pos < available ? samples - pos : available;
+    if (count > 0)
+    {
+      for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+      {
+        if (m_OutChannelPresentFlags & (1 << i))
+          memcpy(array_out[i] + pos, ready.out[i] + m_ReadOffset, count * sizeof(float));
+      }
+      pos          += count;
+      m_ReadOffset += count;
+    }
+
+    if (m_ReadOffset >= ready.samples)
+    {
+      m_ReadOffset = 0;
+      ++m_Read;
+    }
+  }
+
+  return samples;
+}
+
+void *CDSPMasterPipeline::Process(void)
+{
+  CDenormalGuard denormalGuard;
+
+  while (!IsStopped())
+  {
+    unsigned int processed = m_Processed.load(memory_order_relaxed);
+    if (processed == m_Written.load(memory_order_acquire))
+    {
+      Sleep(m_PollInterval);
+      continue;
+    }
+
+    sBlock &block = m_Blocks[processed % MASTER_PIPELINE_SLOTS];
+    for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+    {
+      if (!(m_InChannelPresentFlags & (1 << i)))
+      {
+        memset(block.in[i], 0, block.samples * sizeof(float));
+        break;
+      }
+    }
+
+    block.samples = m_Mode->Process(block.in, block.out, block.samples);
+    m_Processed.store(processed + 1, memory_order_release);
+  }
+
+  return NULL;
+}
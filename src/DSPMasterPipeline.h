@@ -0,0 +1,104 @@
+#pragma once
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Pipelined execution of a master mode.
+ *
+ * The audio thread hands every block to a worker thread and returns the
+ * block processed one call before, so the mode gets a whole block period of
+ * time instead of the rest of the host callback. Blocks travel through a
+ * ring of preallocated slots with one producer and one consumer per index:
+ *
+ *   audio thread:  fill slot m_Written   -> m_Written++
+ *   worker thread: process m_Processed   -> m_Processed++
+ *   audio thread:  read slot m_Read      -> m_Read++
+ *
+ * The output runs a fixed amount of samples behind the input. If the worker
+ * misses a block the output is muted for it, the latency stays the same.
+ *
+ * The audio thread only stores the atomic counters and never takes a lock.
+ * Without input the worker sleeps for a share of the block period and looks
+ * again, a wake-up by event would lock a mutex on the audio thread.
+ */
+
+#include <atomic>
+#include <vector>
+
+#include "kodi_adsp_types.h"
+#include "p8-platform/threads/threads.h"
+
+#define MASTER_PIPELINE_SLOTS         8     //!< Blocks in flight at most
+#define MASTER_PIPELINE_LATENCY       1     //!< Blocks the output runs behind the input
+#define MASTER_PIPELINE_POLL_SHARE    4     //!< Polls of the worker per block period without input
+
+class CDSPProcessMaster;
+
+class CDSPMasterPipeline : public P8PLATFORM::CThread
+{
+public:
+  CDSPMasterPipeline(CDSPProcessMaster *mode);
+  virtual ~CDSPMasterPipeline();
+
+  /*!
+   * Allocate the slots for the stream and start the worker
+   */
+  bool Initialize(const AE_DSP_SETTINGS *settings);
+
+  /*!
+   * Audio thread side, same contract as CDSPProcessMaster::Process
+   */
+  unsigned int ProcessBlock(float **array_in, float **array_out, unsigned int samples);
+
+  /*!
+   * Latency added by the pipeline in seconds
+   */
+  float GetDelay() const;
+  unsigned int GetLatency() const { return m_Latency; }   //!< Samples
+
+  CDSPProcessMaster *GetMode() const { return m_Mode; }
+
+  virtual void *Process(void);
+
+private:
+  struct sBlock
+  {
+    unsigned int  samples;
+    float        *in[AE_DSP_CH_MAX];
+    float        *out[AE_DSP_CH_MAX];
+  };
+
+  CDSPProcessMaster          *m_Mode;
+  unsigned long               m_InChannelPresentFlags;
+  unsigned long               m_OutChannelPresentFlags;
+  unsigned int                m_SamplingRate;
+  unsigned int                m_BlockSize;        //!< Capacity of a slot in samples
+  unsigned int                m_Latency;          //!< Samples
+  unsigned int                m_PollInterval;     //!< Milliseconds the worker sleeps without input
+
+  sBlock                      m_Blocks[MASTER_PIPELINE_SLOTS];
+  std::vector<float>          m_Memory;
+
+  std::atomic<unsigned int>   m_Written;          //!< Blocks filled by the audio thread
+  std::atomic<unsigned int>   m_Processed;        //!< Blocks finished by the worker
+  unsigned int                m_Read;             //!< Blocks fully returned, audio thread only
+  unsigned int                m_ReadOffset;       //!< Samples returned of block m_Read
+  unsigned int                m_Silence;          //!< Samples to return muted before the stream continues
+  unsigned int                m_Skip;             //!< Samples muted by an underrun, dropped on arrival
+};
@@ -17,12 +17,9 @@
  *
  */
 
-#include "libXBMC_addon.h"
-#include "p8-platform/util/util.h"
-#include "p8-platform/util/StdString.h"
+#include <string.h>
 
 #include "DSPProcessMaster.h"
-#include "Process_Stereo/DSPProcessStereo.h"
 
 using namespace std;
 
@@ -31,23 +28,58 @@ CDSPProcessMaster::CDSPProcessMaster(AE_DSP_STREAM_ID streamId, unsigned int mod
     m_ModeId(modeId),
     m_ModeName(modeName)
 {
-  m_ModeInfoStruct.iModeType = AE_DSP_MODE_TYPE_MASTER_PROCESS;
 }
 
 CDSPProcessMaster::~CDSPProcessMaster()
 {
 }
 
-CDSPProcessMaster *CDSPProcessMaster::AllocateMaster(AE_DSP_STREAM_ID streamId, unsigned int modeId)
+std::vector<const sDSPMasterModeDescriptor*> &CDSPMasterModeRegistry::GetModes()
 {
-  CDSPProcessMaster *mode = NULL;
-  switch (modeId)
+  /* constructed on first use, the registrars run during static initialization */
+  static std::vector<const sDSPMasterModeDescriptor*> modes;
+  return modes;
+}
+
+void CDSPMasterModeRegistry::Register(const sDSPMasterModeDescriptor *descriptor)
+{
+  GetModes().push_back(descriptor);
+}
+
+const sDSPMasterModeDescriptor *CDSPMasterModeRegistry::Find(unsigned int modeId)
+{
+  std::vector<const sDSPMasterModeDescriptor*> &modes = GetModes();
+  for (unsigned int i = 0; i < modes.size(); ++i)
   {
-    case ID_MASTER_PROCESS_STEREO_DOWNMIX:
-      mode = new CDSPProcess_StereoDownmix(streamId);
-      break;
-    default:
-      break;
+    if (modes[i]->iModeId == modeId)
+      return modes[i];
   }
-  return mode;
+  return NULL;
+}
+
+bool CDSPMasterModeRegistry::IsSupported(const sDSPMasterModeDescriptor *descriptor, const AE_DSP_SETTINGS *settings, const AE_DSP_STREAM_PROPERTIES *pProperties)
+{
+  if (descriptor->iMinInChannels > 0 && settings->iInChannels < descriptor->iMinInChannels)
+    return false;
+  if (descriptor->iOutChannels > 0 && settings->iOutChannels != descriptor->iOutChannels)
+    return false;
+  if (descriptor->IsSupported && !descriptor->IsSupported(settings, pProperties))
+    return false;
+  return true;
+}
+
+void CDSPMasterModeRegistry::GetModeInfo(const sDSPMasterModeDescriptor *descriptor, AE_DSP_MODES::AE_DSP_MODE &modeInfo)
+{
+  memset(&modeInfo, 0, sizeof(modeInfo));
+  modeInfo.iModeType              = AE_DSP_MODE_TYPE_MASTER_PROCESS;
+  modeInfo.iUniqueDBModeId        = -1;         // set by RegisterMode
+  modeInfo.iModeNumber            = descriptor->iModeId;
+  modeInfo.bHasSettingsDialog     = false;
+  modeInfo.iModeDescription       = descriptor->iModeDescription;
+  modeInfo.iModeHelp              = descriptor->iModeHelp;
+  modeInfo.iModeName              = descriptor->iModeName;
+  modeInfo.iModeSetupName         = -1;
+  modeInfo.iModeSupportTypeFlags  = descriptor->iModeSupportTypeFlags;
+  modeInfo.bIsDisabled            = false;
+  strncpy(modeInfo.strModeName, descriptor->strName, sizeof(modeInfo.strModeName) - 1);
 }
@@ -18,13 +18,72 @@
  *
  */
 
+#include <vector>
+
 #include "kodi_adsp_types.h"
 
 #define ID_MENU_SPEAKER_GAIN_SETUP                      1
 #define ID_MENU_SPEAKER_DISTANCE_SETUP                  2
+#define ID_MENU_SPEAKER_PROFILE                         3
+#define ID_MENU_SPEAKER_CALIBRATION                     4
 
+#define ID_PRE_PROCESS_LOUDNESS_NORMALIZATION           1200
 #define ID_MASTER_PROCESS_STEREO_DOWNMIX                1300
 #define ID_POST_PROCESS_SPEAKER_CORRECTION              1400
+#define ID_POST_PROCESS_DIALOGUE_ENHANCEMENT            1401
+
+#define MASTER_MODE_COST_LIGHT                          1     //!< A few operations per sample and channel
+#define MASTER_MODE_COST_HEAVY                          100   //!< Modes from this cost may be pipelined on a worker thread
+
+class CDSPProcessMaster;
+
+typedef CDSPProcessMaster *(*MasterModeCreate)(unsigned int streamId);
+typedef bool (*MasterModeIsSupported)(const AE_DSP_SETTINGS *settings, const AE_DSP_STREAM_PROPERTIES *pProperties);
+
+/*!
+ * Static description of a master mode. It is all what is needed to register
+ * the mode and to check a stream, an instance is only created for the mode
+ * selected on a stream.
+ */
+struct sDSPMasterModeDescriptor
+{
+  unsigned int            iModeId;
+  const char             *strName;
+  int                     iModeName;              //!< Localized string ids
+  int                     iModeDescription;
+  int                     iModeHelp;
+  unsigned int            iModeSupportTypeFlags;  //!< AE_DSP_PRSNT_ASTREAM_*
+  int                     iMinInChannels;         //!< Supported layouts, 0 for any
+  int                     iOutChannels;           //!< 0 for any
+  unsigned int            iCost;                  //!< Estimate per sample and channel, see MASTER_MODE_COST_*
+  MasterModeIsSupported   IsSupported;            //!< Checks beside the layout, NULL if none
+  MasterModeCreate        Create;
+};
+
+class CDSPMasterModeRegistry
+{
+public:
+  static void Register(const sDSPMasterModeDescriptor *descriptor);
+  static const sDSPMasterModeDescriptor *Find(unsigned int modeId);
+  static bool IsSupported(const sDSPMasterModeDescriptor *descriptor, const AE_DSP_SETTINGS *settings, const AE_DSP_STREAM_PROPERTIES *pProperties);
+
+  /*!
+   * Mode structure for the registration on KODI
+   */
+  static void GetModeInfo(const sDSPMasterModeDescriptor *descriptor, AE_DSP_MODES::AE_DSP_MODE &modeInfo);
+
+private:
+  static std::vector<const sDSPMasterModeDescriptor*> &GetModes();
+};
+
+/*!
+ * A static object of it in the file of a mode adds the mode to the registry
+ */
+class CDSPMasterModeRegistrar
+{
+public:
+  CDSPMasterModeRegistrar(const sDSPMasterModeDescriptor *descriptor) { CDSPMasterModeRegistry::Register(descriptor); }
+};
 
 class CDSPProcessMaster
 {
@@ -36,7 +95,6 @@ public:
   unsigned int GetId() const { return m_ModeId; }
   const char *GetName() { return m_ModeName; }
   virtual const char *GetStreamInfoString() { return ""; }
-  virtual bool IsSupported(const AE_DSP_SETTINGS *settings, const AE_DSP_STREAM_PROPERTIES *pProperties) = 0;
   virtual AE_DSP_ERROR Initialize(const AE_DSP_SETTINGS *settings) = 0;
   virtual void Deinitialize() = 0;
   virtual void ResetSettings() {}
@@ -45,9 +103,11 @@ public:
   virtual unsigned int Process(float **array_in, float **array_out, unsigned int samples) = 0;
   virtual int MasterProcessGetOutChannels(unsigned long &out_channel_present_flags) { return -1; }
 
-  static CDSPProcessMaster *AllocateMaster(unsigned int streamId, unsigned int modeId);
-
-  struct AE_DSP_MODES::AE_DSP_MODE m_ModeInfoStruct;
+  /*!
+   * Samples the mode keeps producing output after the input went silent,
+   * -1 if unknown, such modes are never bypassed on silence
+   */
+  virtual int GetTailLength() const { return -1; }
 
 protected:
   const unsigned int  m_StreamId;
@@ -0,0 +1,92 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "DSPStreamPreset.h"
+#include "filter/compressor.h"
+#include "AudioDSPBasic.h"
+
+using namespace std;
+
+/*
+ * Music is left as produced, only the speaker correction applies. Movies
+ * get the night mode compressor and the dialogue enhancement, broadcast
+ * audio the loudness normalization against the jumps between programmes.
+ *
+ * AE_DSP_ASTREAM_INVALID matches every stream type, such rules only see the
+ * streams which the type rules above them did not take. The ac3 rule thus
+ * treats multichannel AC-3 of any type but music and movie like a movie.
+ */
+static const sDSPStreamPresetRule g_StreamPresetRules[] =
+{
+  { AE_DSP_ASTREAM_MUSIC,   PRESET_ANY_CODEC, PRESET_ANY_CHANNELS,
+    { "music",      0, DYNAMIC_RANGE_OFF,        0,                      0                        } },
+  { AE_DSP_ASTREAM_MOVIE,   PRESET_ANY_CODEC, PRESET_ANY_CHANNELS,
+    { "movie",      PRESET_FOLLOW_SETTING, DYNAMIC_RANGE_NIGHT_MODE, DIALOGUE_BOOST_DEFAULT, DIALOGUE_DUCKING_DEFAULT } },
+  { AE_DSP_ASTREAM_INVALID, "mp2",            PRESET_ANY_CHANNELS,
+    { "broadcast",  1, DYNAMIC_RANGE_LIMITER,    PRESET_FOLLOW_SETTING,  PRESET_FOLLOW_SETTING    } },
+  { AE_DSP_ASTREAM_INVALID, "ac3",            3,
+    { "movie",      PRESET_FOLLOW_SETTING, DYNAMIC_RANGE_NIGHT_MODE, DIALOGUE_BOOST_DEFAULT, DIALOGUE_DUCKING_DEFAULT } },
+  { AE_DSP_ASTREAM_INVALID, PRESET_ANY_CODEC, PRESET_ANY_CHANNELS,
+    { "default",    PRESET_FOLLOW_SETTING, PRESET_FOLLOW_SETTING, PRESET_FOLLOW_SETTING, PRESET_FOLLOW_SETTING } },
+};
+
+#define STREAM_PRESET_RULES   (sizeof(g_StreamPresetRules) / sizeof(g_StreamPresetRules[0]))
+
+const sDSPStreamPreset &CDSPStreamPresetResolver::GetDefault()
+{
+  return g_StreamPresetRules[STREAM_PRESET_RULES - 1].preset;
+}
+
+bool CDSPStreamPresetResolver::Matches(const sDSPStreamPresetRule &rule, int streamType, const string &codec, int channels)
+{
+  if (rule.iStreamType != AE_DSP_ASTREAM_INVALID && rule.iStreamType != streamType)
+    return false;
+  if (rule.strCodec != PRESET_ANY_CODEC && codec != rule.strCodec)
+    return false;
+  if (rule.iMinChannels != PRESET_ANY_CHANNELS && channels < rule.iMinChannels)
+    return false;
+  return true;
+}
+
+const sDSPStreamPreset &CDSPStreamPresetResolver::Resolve(int streamType, const string &codec, int channels)
+{
+  char key[32];
+  snprintf(key, sizeof(key), "%i:%i:", streamType, channels);
+  string strKey = key + codec;
+
+  map<string, const sDSPStreamPreset*>::iterator it = m_Resolved.find(strKey);
+  if (it != m_Resolved.end())
+    return *it->second;
+
+  const sDSPStreamPreset *preset = &GetDefault();
+  for (unsigned int i = 0; i < STREAM_PRESET_RULES; ++i)
+  {
+    if (Matches(g_StreamPresetRules[i], streamType, codec, channels))
+    {
+      preset = &g_StreamPresetRules[i].preset;
+      break;
+    }
+  }
+
+  m_Resolved.insert(make_pair(strKey, preset));
+  return *preset;
+}
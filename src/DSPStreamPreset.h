@@ -0,0 +1,86 @@
+#pragma once
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Processing presets per kind of stream.
+ *
+ * A small rule table maps the stream type, the codec and the channel count
+ * given on StreamCreate to a parameter set for the loudness, dynamic range
+ * and dialogue stages. The first matching rule wins. A preset value only
+ * replaces a setting which the user left at its default. The result is resolved
+ * once per stream, the stages are then set up with it and the block
+ * processing has nothing left to decide. Resolved combinations are cached,
+ * a new stream of the same kind costs one map lookup.
+ */
+
+#include <map>
+#include <string>
+
+#include "kodi_adsp_types.h"
+
+#define PRESET_FOLLOW_SETTING       -1    //!< Value of a preset field which leaves the add-on setting in charge
+#define PRESET_ANY_CODEC            NULL
+#define PRESET_ANY_CHANNELS         0
+
+struct sDSPStreamPreset
+{
+  const char   *strName;
+  int           iLoudness;          //!< 1 on, 0 off
+  int           iDynamicRange;      //!< DYNAMIC_RANGE_*
+  int           iDialogueBoost;     //!< dB
+  int           iDialogueDucking;   //!< dB
+};
+
+struct sDSPStreamPresetRule
+{
+  int                 iStreamType;    //!< AE_DSP_ASTREAM_*, AE_DSP_ASTREAM_INVALID matches all
+  const char         *strCodec;       //!< Codec id as given by the player, PRESET_ANY_CODEC matches all
+  int                 iMinChannels;   //!< PRESET_ANY_CHANNELS matches all
+  sDSPStreamPreset    preset;
+};
+
+class CDSPStreamPresetResolver
+{
+public:
+  /*!
+   * Preset for the stream, the last table entry is used if no rule matches
+   */
+  const sDSPStreamPreset &Resolve(int streamType, const std::string &codec, int channels);
+
+  /*!
+   * Preset which leaves all stages to the add-on settings
+   */
+  static const sDSPStreamPreset &GetDefault();
+
+  /*!
+   * Value for a stage, the preset value if set and the setting is still at its default
+   */
+  static int Apply(int presetValue, int settingValue, int settingDefault)
+  {
+    if (presetValue == PRESET_FOLLOW_SETTING || settingValue != settingDefault)
+      return settingValue;
+    return presetValue;
+  }
+
+private:
+  static bool Matches(const sDSPStreamPresetRule &rule, int streamType, const std::string &codec, int channels);
+
+  std::map<std::string, const sDSPStreamPreset*> m_Resolved;
+};
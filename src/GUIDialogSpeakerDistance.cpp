@@ -45,8 +45,9 @@ using namespace ADDON;
 #define DELAY_UNIT_FEET                           4
 #define DELAY_UNIT_INCHES                         5
 
-CGUIDialogSpeakerDistance::CGUIDialogSpeakerDistance(unsigned int streamId)
-    : m_StreamId(streamId)
+CGUIDialogSpeakerDistance::CGUIDialogSpeakerDistance(unsigned int streamId, int profile)
+    : CDSPSettings(profile)
+    , m_StreamId(streamId)
     , m_window(NULL)
     , m_spinSpeakerDistanceUnit(NULL)
 {
@@ -25,7 +25,7 @@
 class CGUIDialogSpeakerDistance : private CDSPSettings
 {
 public:
-  CGUIDialogSpeakerDistance(unsigned int streamId);
+  CGUIDialogSpeakerDistance(unsigned int streamId, int profile);
   virtual ~CGUIDialogSpeakerDistance();
 
   bool Show();
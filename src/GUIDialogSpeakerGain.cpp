@@ -40,8 +40,9 @@ using namespace ADDON;
 
 #define ACTION_NAV_BACK                          92
 
-CGUIDialogSpeakerGain::CGUIDialogSpeakerGain(unsigned int streamId)
-    : m_StreamId(streamId)
+CGUIDialogSpeakerGain::CGUIDialogSpeakerGain(unsigned int streamId, int profile)
+    : CDSPSettings(profile)
+    , m_StreamId(streamId)
     , m_GainTestSound(SOUND_TEST_OFF)
     , m_window(NULL)
     , m_spinSpeakerGainTest(NULL)
@@ -162,6 +163,13 @@ bool CGUIDialogSpeakerGain::OnInit()
   m_spinSpeakerGainTest->AddLabel(KODI->GetLocalizedString(30049), SOUND_TEST_OFF);
   m_spinSpeakerGainTest->AddLabel(KODI->GetLocalizedString(30050), SOUND_TEST_PINK_NOICE);
   m_spinSpeakerGainTest->AddLabel(KODI->GetLocalizedString(30051), SOUND_TEST_VOICE);
+  m_spinSpeakerGainTest->AddLabel(KODI->GetLocalizedString(30099), SOUND_TEST_SWEEP);
+  m_spinSpeakerGainTest->AddLabel(KODI->GetLocalizedString(30104), SOUND_TEST_PINK_NOISE_BAND);
+  m_spinSpeakerGainTest->AddLabel(KODI->GetLocalizedString(30105), SOUND_TEST_SINE);
+  m_spinSpeakerGainTest->AddLabel(KODI->GetLocalizedString(30106), SOUND_TEST_LOG_SWEEP);
+  m_spinSpeakerGainTest->AddLabel(KODI->GetLocalizedString(30107), SOUND_TEST_IMPULSE);
+  m_spinSpeakerGainTest->AddLabel(KODI->GetLocalizedString(30108), SOUND_TEST_CHIRP);
+  m_spinSpeakerGainTest->AddLabel(KODI->GetLocalizedString(30124), SOUND_TEST_PINK_NOISE_FILTER);
 
   m_radioSpeakerContinuesTest = GUI->Control_getRadioButton(m_window, SPIN_CONTROL_SPEAKER_CONTINUES_TEST);
   m_radioSpeakerContinuesTest->SetSelected(false);
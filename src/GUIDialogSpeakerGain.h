@@ -25,7 +25,7 @@
 class CGUIDialogSpeakerGain : private CDSPSettings
 {
 public:
-  CGUIDialogSpeakerGain(unsigned int streamId);
+  CGUIDialogSpeakerGain(unsigned int streamId, int profile);
   virtual ~CGUIDialogSpeakerGain();
 
   bool Show();
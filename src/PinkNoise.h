@@ -22,64 +22,124 @@
 /*
  *  pink noise generating class using the Voss-McCartney algorithm, as
  *  described at www.firstpr.com.au/dsp/pink-noise/
+ *
+ *  As alternative the filtered method of Paul Kellet is available, the
+ *  one pole filters of his bank are kept side by side as lanes, so the
+ *  per sample update is a single vector multiply-add.
+ *
+ *  Random values come from a PCG32 generator owned by every instance, it
+ *  takes no lock and is seedable, so the output is reproducible.
  */
 
-#include <stdlib.h>
+#include <stdint.h>
+#if defined(TARGET_WINDOWS)
+  #include <intrin.h>
+#endif
 
-typedef unsigned int CounterType;
+typedef uint32_t CounterType;
 typedef float DataValue;
 
 const int n_generators = 8 * sizeof(CounterType);
 
+#define PINK_NOISE_VOSS_MCCARTNEY   0
+#define PINK_NOISE_KELLET           1
+
+#define PINK_NOISE_DEFAULT_SEED     0x853c49e6748fea9bULL
+#define PINK_NOISE_KELLET_LANES     8
+#define PINK_NOISE_KELLET_SCALE     0.0581f //!< Scales the filter bank output down to the RMS of getValue(), which is 1 / sqrt(3 * n_generators)
+
 class cPinkNoise
 {
 private:
   CounterType m_counter;
-  DataValue *m_generators;
+  DataValue m_generators[n_generators];
   DataValue m_lastValue;
 
+  uint64_t m_state;
+  uint64_t m_increment;
+
+  int m_method;
+  DataValue m_kellet[PINK_NOISE_KELLET_LANES];
+  DataValue m_kelletDelay;
+
+  /* PCG32 XSH RR, see www.pcg-random.org */
+  inline uint32_t nextRandom()
+  {
+    uint64_t old = m_state;
+    m_state = old * 6364136223846793005ULL + m_increment;
+    uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = (uint32_t)(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+  }
+
+  /* white noise in -1 .. 1 */
+  inline DataValue nextWhite()
+  {
+    return (DataValue)(int32_t)nextRandom() * (1.0f / 2147483648.0f);
+  }
+
+  static inline int countTrailingZeros(CounterType n)
+  {
+#if defined(TARGET_WINDOWS)
+    unsigned long index;
+    _BitScanForward(&index, n);
+    return (int)index;
+#else
+    return __builtin_ctz(n);
+#endif
+  }
+
 public:
-  cPinkNoise()
+  cPinkNoise(uint64_t seed = PINK_NOISE_DEFAULT_SEED, int method = PINK_NOISE_VOSS_MCCARTNEY)
+    : m_method(method)
   {
-    m_generators = new DataValue[n_generators];
-    reset();
+    this->seed(seed);
   }
 
   ~cPinkNoise()
   {
-    delete [] m_generators;
   };
 
+  void seed(uint64_t seed)
+  {
+    m_state = 0;
+    m_increment = (seed << 1u) | 1u;
+    nextRandom();
+    m_state += seed;
+    nextRandom();
+    reset();
+  }
+
+  void setMethod(int method)
+  {
+    m_method = method;
+  }
+
   void reset()
   {
     m_counter = 0;
     m_lastValue = 0;
     for (int i = 0; i < n_generators; ++i)
     {
-      m_generators[i] = 2 * (rand() / DataValue(RAND_MAX)) - 1;
+      m_generators[i] = nextWhite();
       m_lastValue += m_generators[i];
     }
+
+    for (int i = 0; i < PINK_NOISE_KELLET_LANES; ++i)
+      m_kellet[i] = 0;
+    m_kelletDelay = 0;
   }
 
   inline DataValue getUnscaledValue()
   {
     if (m_counter != 0)
     {
-      // set index to number of trailing zeros in m_counter.
-      // hangs if m_counter==0, hence the slightly inefficient
-      // test above.
-      CounterType n = m_counter;
-      int index = 0;
-      while ( (n & 1) == 0 )
-      {
-        n >>= 1;
-        index++;
-        // this loop means that the plugins cannot be labelled as
-        // capable of hard real-time performance.
-      }
+      // set index to number of trailing zeros in m_counter,
+      // undefined for m_counter==0, hence the test above.
+      int index = countTrailingZeros(m_counter);
 
       m_lastValue -= m_generators[index];
-      m_generators[index] = 2 * (rand() / DataValue(RAND_MAX)) - 1;
+      m_generators[index] = nextWhite();
       m_lastValue += m_generators[index];
     }
 
@@ -102,6 +162,53 @@ public:
   {
     // adding some white noise gets rid of some nulls in the frequency spectrum
     // but makes the signal spikier, so possibly not so good for control signals.
-    return (getUnscaledValue() + rand() / DataValue(RAND_MAX * 0.5) - 1) / (n_generators + 1);
+    return (getUnscaledValue() + nextWhite()) / (n_generators + 1);
+  }
+
+  /*!
+   * Fill a block with pink noise of the selected method, the Voss-McCartney
+   * output is the same sequence as from getValue()
+   */
+  void Generate(DataValue *out, unsigned int samples)
+  {
+    if (m_method == PINK_NOISE_KELLET)
+    {
+      GenerateKellet(out, samples);
+      return;
+    }
+
+    for (unsigned int pos = 0; pos < samples; ++pos)
+      out[pos] = getValue();
+  }
+
+  void GenerateKellet(DataValue *out, unsigned int samples)
+  {
+    /* Paul Kellet's refined method, the last lane is the direct white part */
+    static const DataValue pole[PINK_NOISE_KELLET_LANES] =
+      { 0.99886f, 0.99332f, 0.96900f, 0.86650f, 0.55000f, -0.7616f, 0.0f, 0.0f };
+    static const DataValue gain[PINK_NOISE_KELLET_LANES] =
+      { 0.0555179f, 0.0750759f, 0.1538520f, 0.3104856f, 0.5329522f, -0.0168980f, 0.0f, 0.5362f };
+
+    DataValue lanes[PINK_NOISE_KELLET_LANES];
+    for (int i = 0; i < PINK_NOISE_KELLET_LANES; ++i)
+      lanes[i] = m_kellet[i];
+    DataValue delay = m_kelletDelay;
+
+    for (unsigned int pos = 0; pos < samples; ++pos)
+    {
+      DataValue white = nextWhite();
+      DataValue sum = delay;
+      for (int i = 0; i < PINK_NOISE_KELLET_LANES; ++i)
+      {
+        lanes[i] = pole[i] * lanes[i] + gain[i] * white;
+        sum += lanes[i];
+      }
+      delay = white * 0.115926f;
+      out[pos] = sum * PINK_NOISE_KELLET_SCALE;
+    }
+
+    for (int i = 0; i < PINK_NOISE_KELLET_LANES; ++i)
+      m_kellet[i] = lanes[i];
+    m_kelletDelay = delay;
   }
 };
@@ -22,59 +22,61 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "libXBMC_addon.h"
-#include "libKODI_adsp.h"
-
 #include "DSPProcessStereo.h"
-#include "../addon.h"
-#include "../AudioDSPBasic.h"
 
-/* The non-zero taps of the Hilbert transformer */
+/* The non-zero taps of the Hilbert transformer, 2 / (pi * n) windowed */
 static float xcoeffs[] = {
-  +0.0008103736f, +0.0008457886f, +0.0009017196f, +0.0009793364f,
-  +0.0010798341f, +0.0012044365f, +0.0013544008f, +0.0015310235f,
-  +0.0017356466f, +0.0019696659f, +0.0022345404f, +0.0025318040f,
-  +0.0028630784f, +0.0032300896f, +0.0036346867f, +0.0040788644f,
-  +0.0045647903f, +0.0050948365f, +0.0056716186f, +0.0062980419f,
-  +0.0069773575f, +0.0077132300f, +0.0085098208f, +0.0093718901f,
-  +0.0103049226f, +0.0113152847f, +0.0124104218f, +0.0135991079f,
-  +0.0148917649f, +0.0163008758f, +0.0178415242f, +0.0195321089f,
-  +0.0213953037f, +0.0234593652f, +0.0257599469f, +0.0283426636f,
-  +0.0312667947f, +0.0346107648f, +0.0384804823f, +0.0430224431f,
-  +0.0484451086f, +0.0550553725f, +0.0633242001f, +0.0740128560f,
-  +0.0884368322f, +0.1090816773f, +0.1412745301f, +0.1988673273f,
-  +0.3326528346f, +0.9997730178f, -0.9997730178f, -0.3326528346f,
-  -0.1988673273f, -0.1412745301f, -0.1090816773f, -0.0884368322f,
-  -0.0740128560f, -0.0633242001f, -0.0550553725f, -0.0484451086f,
-  -0.0430224431f, -0.0384804823f, -0.0346107648f, -0.0312667947f,
-  -0.0283426636f, -0.0257599469f, -0.0234593652f, -0.0213953037f,
-  -0.0195321089f, -0.0178415242f, -0.0163008758f, -0.0148917649f,
-  -0.0135991079f, -0.0124104218f, -0.0113152847f, -0.0103049226f,
-  -0.0093718901f, -0.0085098208f, -0.0077132300f, -0.0069773575f,
-  -0.0062980419f, -0.0056716186f, -0.0050948365f, -0.0045647903f,
-  -0.0040788644f, -0.0036346867f, -0.0032300896f, -0.0028630784f,
-  -0.0025318040f, -0.0022345404f, -0.0019696659f, -0.0017356466f,
-  -0.0015310235f, -0.0013544008f, -0.0012044365f, -0.0010798341f,
-  -0.0009793364f, -0.0009017196f, -0.0008457886f, -0.0008103736f,
+  +0.0005158999f, +0.0005384457f, +0.0005740525f, +0.0006234649f,
+  +0.0006874437f, +0.0007667681f, +0.0008622383f, +0.0009746798f,
+  +0.0011049469f, +0.0012539283f, +0.0014225526f, +0.0016117965f,
+  +0.0018226923f, +0.0020563389f, +0.0023139134f, +0.0025966857f,
+  +0.0029060358f, +0.0032434737f, +0.0036106645f, +0.0040094580f,
+  +0.0044419237f, +0.0049103947f, +0.0054175202f, +0.0059663305f,
+  +0.0065603175f, +0.0072035340f, +0.0079007199f, +0.0086574610f,
+  +0.0094803920f, +0.0103774598f, +0.0113582671f, +0.0124345267f,
+  +0.0136206734f, +0.0149346957f, +0.0163992915f, +0.0180435000f,
+  +0.0199050597f, +0.0220338972f, +0.0244974359f, +0.0273889379f,
+  +0.0308411140f, +0.0350493387f, +0.0403134379f, +0.0471180475f,
+  +0.0563006360f, +0.0694435526f, +0.0899381592f, +0.1266028726f,
+  +0.2117733718f, +0.6364752710f, -0.6364752710f, -0.2117733718f,
+  -0.1266028726f, -0.0899381592f, -0.0694435526f, -0.0563006360f,
+  -0.0471180475f, -0.0403134379f, -0.0350493387f, -0.0308411140f,
+  -0.0273889379f, -0.0244974359f, -0.0220338972f, -0.0199050597f,
+  -0.0180435000f, -0.0163992915f, -0.0149346957f, -0.0136206734f,
+  -0.0124345267f, -0.0113582671f, -0.0103774598f, -0.0094803920f,
+  -0.0086574610f, -0.0079007199f, -0.0072035340f, -0.0065603175f,
+  -0.0059663305f, -0.0054175202f, -0.0049103947f, -0.0044419237f,
+  -0.0040094580f, -0.0036106645f, -0.0032434737f, -0.0029060358f,
+  -0.0025966857f, -0.0023139134f, -0.0020563389f, -0.0018226923f,
+  -0.0016117965f, -0.0014225526f, -0.0012539283f, -0.0011049469f,
+  -0.0009746798f, -0.0008622383f, -0.0007667681f, -0.0006874437f,
+  -0.0006234649f, -0.0005740525f, -0.0005384457f, -0.0005158999f,
+};
+
+static CDSPProcessMaster *CreateStereoDownmix(unsigned int streamId)
+{
+  return new CDSPProcess_StereoDownmix(streamId);
+}
+
+/* For surround downmix 5.1 to 2.0, the Hilbert transform of the surround
+ * channels makes it a heavy mode */
+static const sDSPMasterModeDescriptor g_StereoDownmixDescriptor =
+{
+  ID_MASTER_PROCESS_STEREO_DOWNMIX,
+  "StereoDownmix",
+  30000, 30002, 30003,
+  AE_DSP_PRSNT_ASTREAM_BASIC | AE_DSP_PRSNT_ASTREAM_MUSIC | AE_DSP_PRSNT_ASTREAM_MOVIE,
+  3, 2,
+  MASTER_MODE_COST_HEAVY,
+  NULL,
+  CreateStereoDownmix
 };
 
+static CDSPMasterModeRegistrar g_StereoDownmixRegistrar(&g_StereoDownmixDescriptor);
+
 CDSPProcess_StereoDownmix::CDSPProcess_StereoDownmix(unsigned int streamId)
   : CDSPProcessMaster(streamId, ID_MASTER_PROCESS_STEREO_DOWNMIX, "StereoDownmix")
 {
-  m_ModeInfoStruct.iUniqueDBModeId        = -1;         // set by RegisterMode
-  m_ModeInfoStruct.iModeNumber            = ID_MASTER_PROCESS_STEREO_DOWNMIX;
-  m_ModeInfoStruct.bHasSettingsDialog     = false;
-  m_ModeInfoStruct.iModeDescription       = 30002;
-  m_ModeInfoStruct.iModeHelp              = 30003;
-  m_ModeInfoStruct.iModeName              = 30000;
-  m_ModeInfoStruct.iModeSetupName         = -1;
-  m_ModeInfoStruct.iModeSupportTypeFlags  = AE_DSP_PRSNT_ASTREAM_BASIC | AE_DSP_PRSNT_ASTREAM_MUSIC | AE_DSP_PRSNT_ASTREAM_MOVIE;
-  m_ModeInfoStruct.bIsDisabled            = false;
-
-  strncpy(m_ModeInfoStruct.strModeName, m_ModeName, sizeof(m_ModeInfoStruct.strModeName) - 1);
-  memset(m_ModeInfoStruct.strOwnModeImage, 0, sizeof(m_ModeInfoStruct.strOwnModeImage)); // unused
-  memset(m_ModeInfoStruct.strOverrideModeImage, 0, sizeof(m_ModeInfoStruct.strOverrideModeImage)); // unused
-
   m_DelayRL = (float*) calloc(D_SIZE, sizeof(float));
   m_DelayRR = (float*) calloc(D_SIZE, sizeof(float));
 }
@@ -90,15 +92,6 @@ const char *CDSPProcess_StereoDownmix::GetName()
   return m_ModeName;
 }
 
-bool CDSPProcess_StereoDownmix::IsSupported(const AE_DSP_SETTINGS *settings, const AE_DSP_STREAM_PROPERTIES *pProperties)
-{
-  /* For surround downmix 5.1 to 2.0 */
-  if (settings->iInChannels > 2 && settings->iOutChannels == 2)
-    return true;
-
-  return false;
-}
-
 AE_DSP_ERROR CDSPProcess_StereoDownmix::Initialize(const AE_DSP_SETTINGS *settings)
 {
   m_SampleRate    = settings->iProcessSamplerate;
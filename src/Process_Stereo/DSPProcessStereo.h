@@ -56,10 +56,10 @@ public:
   virtual ~CDSPProcess_StereoDownmix();
 
   virtual const char *GetName();
-  virtual bool IsSupported(const AE_DSP_SETTINGS *settings, const AE_DSP_STREAM_PROPERTIES *pProperties);
   virtual AE_DSP_ERROR Initialize(const AE_DSP_SETTINGS *settings);
   virtual void Deinitialize() {}
   virtual float GetDelay();
   virtual unsigned int Process(float **array_in, float **array_out, unsigned int samples);
   virtual int MasterProcessGetOutChannels(unsigned long &out_channel_present_flags);
+  virtual int GetTailLength() const { return D_SIZE; }
 };
@@ -24,6 +24,7 @@
 #include "p8-platform/util/util.h"
 #include "p8-platform/util/StdString.h"
 #include "AudioDSPBasic.h"
+#include "filter/denormal.h"
 
 using namespace std;
 using namespace ADDON;
@@ -184,13 +185,18 @@ AE_DSP_ERROR CallMenuHook(const AE_DSP_MENUHOOK &menuhook, const AE_DSP_MENUHOOK
 
 AE_DSP_ERROR StreamCreate(const AE_DSP_SETTINGS *addonSettings, const AE_DSP_STREAM_PROPERTIES* pProperties, ADDON_HANDLE handle)
 {
+  /* the stream objects are pooled per slot, a stream still open on it is
+   * reset in place so its buffers are reused */
+  cDSPProcessorStream *proc = g_DSPProcessor.GetPooledStream(addonSettings->iStreamID);
+  if (proc == NULL)
+    return AE_DSP_ERROR_UNKNOWN;
+
   if (g_usedDSPs[addonSettings->iStreamID])
   {
-    delete g_usedDSPs[addonSettings->iStreamID];
     g_usedDSPs[addonSettings->iStreamID] = NULL;
+    proc->StreamDestroy();
   }
 
-  cDSPProcessorStream *proc = new cDSPProcessorStream(addonSettings->iStreamID);
   AE_DSP_ERROR err = proc->StreamCreate(addonSettings, pProperties);
   if (err == AE_DSP_ERROR_NO_ERROR)
   {
@@ -199,17 +205,15 @@ AE_DSP_ERROR StreamCreate(const AE_DSP_SETTINGS *addonSettings, const AE_DSP_STR
     handle->callerAddress = proc;
   }
   else
-    delete proc;
+    proc->StreamDestroy();
 
   return err;
 }
 
 AE_DSP_ERROR StreamDestroy(const ADDON_HANDLE handle)
 {
-  AE_DSP_ERROR err = ((cDSPProcessorStream*)handle->callerAddress)->StreamDestroy();
-  delete ((cDSPProcessorStream*)handle->callerAddress);
   g_usedDSPs[handle->dataIdentifier] = NULL;
-  return err;
+  return ((cDSPProcessorStream*)handle->callerAddress)->StreamDestroy();
 }
 
 AE_DSP_ERROR StreamInitialize(const ADDON_HANDLE handle, const AE_DSP_SETTINGS *settings)
@@ -229,6 +233,7 @@ AE_DSP_ERROR StreamIsModeSupported(const ADDON_HANDLE handle, AE_DSP_MODE_TYPE t
 
 bool InputProcess(const ADDON_HANDLE handle, const float **array_in, unsigned int samples)
 {
+  CDenormalGuard denormalGuard;
   return ((cDSPProcessorStream*)handle->callerAddress)->InputProcess(array_in, samples);
 }
 
@@ -255,6 +260,7 @@ float InputResampleGetDelay(const ADDON_HANDLE handle)
 
 unsigned int InputResampleProcess(const ADDON_HANDLE handle, float **array_in, float **array_out, unsigned int samples)
 {
+  CDenormalGuard denormalGuard;
   return ((cDSPProcessorStream*)handle->callerAddress)->InputResampleProcess(array_in, array_out, samples);
 }
 
@@ -276,6 +282,7 @@ float PreProcessGetDelay(const ADDON_HANDLE handle, unsigned int mode_id)
 
 unsigned int PreProcess(const ADDON_HANDLE handle, unsigned int mode_id, float **array_in, float **array_out, unsigned int samples)
 {
+  CDenormalGuard denormalGuard;
   return ((cDSPProcessorStream*)handle->callerAddress)->PreProcess(array_in, array_out, samples);
 }
 
@@ -301,6 +308,7 @@ float MasterProcessGetDelay(const ADDON_HANDLE handle)
 
 unsigned int MasterProcess(const ADDON_HANDLE handle, float **array_in, float **array_out, unsigned int samples)
 {
+  CDenormalGuard denormalGuard;
   return ((cDSPProcessorStream*)handle->callerAddress)->MasterProcess(array_in, array_out, samples);
 }
 
@@ -332,6 +340,7 @@ float PostProcessGetDelay(const ADDON_HANDLE handle, unsigned int mode_id)
 
 unsigned int PostProcess(const ADDON_HANDLE handle, unsigned int mode_id, float **array_in, float **array_out, unsigned int samples)
 {
+  CDenormalGuard denormalGuard;
   return ((cDSPProcessorStream*)handle->callerAddress)->PostProcess(mode_id, array_in, array_out, samples);
 }
 
@@ -358,6 +367,7 @@ float OutputResampleGetDelay(const ADDON_HANDLE handle)
 
 unsigned int OutputResampleProcess(const ADDON_HANDLE handle, float **array_in, float **array_out, unsigned int samples)
 {
+  CDenormalGuard denormalGuard;
   return ((cDSPProcessorStream*)handle->callerAddress)->OutputResampleProcess(array_in,  array_out, samples);
 }
 
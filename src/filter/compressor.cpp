@@ -0,0 +1,263 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "compressor.h"
+#include "denormal.h"
+
+CCompressor::CCompressor()
+  : m_ChannelPresentFlags(0)
+  , m_SamplingRate(0)
+  , m_Latency(0)
+  , m_Threshold(1.0f)
+  , m_Exponent(0.0f)
+  , m_Makeup(1.0f)
+  , m_Ceiling(1.0f)
+  , m_AttackCoeff(0.0f)
+  , m_ReleaseCoeff(0.0f)
+  , m_LimiterRelease(0.0f)
+{
+  memset(m_LookAhead, 0, sizeof(m_LookAhead));
+
+  m_Settings.bCompress      = false;
+  m_Settings.bRMSDetection  = true;
+  m_Settings.fThreshold     = -24.0f;
+  m_Settings.fRatio         = 4.0f;
+  m_Settings.fAttack        = 10.0f;
+  m_Settings.fRelease       = 250.0f;
+}
+
+CCompressor::~CCompressor()
+{
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+    delete m_LookAhead[i];
+}
+
+void CCompressor::Init(unsigned long channelPresentFlags, unsigned int samplingRate, unsigned int maxSamples)
+{
+  m_ChannelPresentFlags = channelPresentFlags;
+  m_SamplingRate        = samplingRate;
+  m_Latency             = 0;
+
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    if (m_ChannelPresentFlags & (1 << i))
+    {
+      if (m_LookAhead[i] == NULL)
+        m_LookAhead[i] = new CDelay;
+      m_LookAhead[i]->Init(COMPRESSOR_LOOKAHEAD, m_SamplingRate);
+      m_Latency = m_LookAhead[i]->GetLatency();
+    }
+    else if (m_LookAhead[i] != NULL)
+    {
+      delete m_LookAhead[i];
+      m_LookAhead[i] = NULL;
+    }
+  }
+  if (m_Latency < 1)
+    m_Latency = 1;
+  if (maxSamples < 1)
+    maxSamples = 1;
+
+  /* larger blocks are processed in parts of this size, see Process */
+  m_Detector.resize(maxSamples);
+  m_Gain.resize(maxSamples);
+  m_HoldValue.resize(m_Latency + 1);
+  m_HoldIndex.resize(m_Latency + 1);
+  m_Smooth.resize(m_Latency);
+
+  SetParameters(m_Settings);
+  Flush();
+}
+
+void CCompressor::SetParameters(const sCompressorSettings &settings)
+{
+  m_Settings = settings;
+  if (m_Settings.fRatio < 1.0f)
+    m_Settings.fRatio = 1.0f;
+
+  float rate = m_SamplingRate > 0 ? (float)m_SamplingRate : 48000.0f;
+
+  /* A full scale signal is reduced by -threshold * (1 - 1/ratio) dB, the makeup
+   * gives back a part of it so night mode is not much quieter than the source */
+  m_Threshold       = powf(10.0f, m_Settings.fThreshold * 0.05f);
+  m_Exponent        = 1.0f / m_Settings.fRatio - 1.0f;
+  m_Makeup          = powf(10.0f, -m_Settings.fThreshold * (1.0f - 1.0f / m_Settings.fRatio) * COMPRESSOR_MAKEUP_PART * 0.05f);
+  m_Ceiling         = powf(10.0f, COMPRESSOR_CEILING_DB * 0.05f);
+  m_AttackCoeff     = expf(-1000.0f / (m_Settings.fAttack * rate));
+  m_ReleaseCoeff    = expf(-1000.0f / (m_Settings.fRelease * rate));
+  m_LimiterRelease  = expf(-1000.0f / (COMPRESSOR_LIMITER_RELEASE * rate));
+
+  /* the RMS detector works on the squared signal */
+  if (m_Settings.bRMSDetection)
+  {
+    m_Threshold *= m_Threshold;
+    m_Exponent  *= 0.5f;
+  }
+}
+
+void CCompressor::Flush()
+{
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    if (m_LookAhead[i] != NULL)
+      m_LookAhead[i]->Flush();
+  }
+
+  m_Envelope    = 0.0f;
+  m_LimiterGain = 1.0f;
+  m_HoldHead    = 0;
+  m_HoldCount   = 0;
+  m_Position    = 0;
+
+  m_Smooth.assign(m_Latency, 1.0f);
+  m_SmoothPtr   = 0;
+  m_SmoothSum   = m_Latency;
+}
+
+unsigned int CCompressor::GetLatency() const
+{
+  return m_Latency;
+}
+
+unsigned int CCompressor::GetTailLength() const
+{
+  float release = m_Settings.bCompress && m_Settings.fRelease > COMPRESSOR_LIMITER_RELEASE ? m_Settings.fRelease : COMPRESSOR_LIMITER_RELEASE;
+  return m_Latency + (unsigned int)(COMPRESSOR_TAIL_RELEASES * release * 0.001f * m_SamplingRate);
+}
+
+void CCompressor::Detect(float **array, unsigned int offset, unsigned int samples)
+{
+  float *detector = &m_Detector[0];
+  memset(detector, 0, samples * sizeof(float));
+
+  /* Channel outer, sample inner: each pass is a plain max over a contiguous
+   * block which the compiler turns into packed SIMD compares. */
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    if (!(m_ChannelPresentFlags & (1 << i)))
+      continue;
+
+    const float *in = array[i] + offset;
+    if (m_Settings.bRMSDetection)
+    {
+      for (unsigned int pos = 0; pos < samples; ++pos)
+      {
+        float level = in[pos] * in[pos];
+        detector[pos] = level > detector[pos] ? level : detector[pos];
+      }
+    }
+    else
+    {
+      for (unsigned int pos = 0; pos < samples; ++pos)
+      {
+        float level = fabsf(in[pos]);
+        detector[pos] = level > detector[pos] ? level : detector[pos];
+      }
+    }
+  }
+}
+
+void CCompressor::ComputeGain(unsigned int samples)
+{
+  const unsigned int holdSize = m_Latency + 1;
+  const float ceiling = m_Settings.bRMSDetection ? m_Ceiling * m_Ceiling : m_Ceiling;
+
+  for (unsigned int pos = 0; pos < samples; ++pos)
+  {
+    float level  = m_Detector[pos];
+    float target = 1.0f;
+
+    if (m_Settings.bCompress)
+    {
+      /* the offset keeps the released envelope out of the denormal range */
+      if (level > m_Envelope)
+        m_Envelope = m_AttackCoeff * m_Envelope + (1.0f - m_AttackCoeff) * level;
+      else
+        m_Envelope = m_ReleaseCoeff * m_Envelope + (1.0f - m_ReleaseCoeff) * level + DENORMAL_OFFSET;
+
+      target = m_Makeup;
+      if (m_Envelope > m_Threshold)
+        target *= powf(m_Envelope / m_Threshold, m_Exponent);
+    }
+
+    /* brickwall limiter, detector level is squared on RMS detection */
+    float gain = m_Settings.bRMSDetection ? target * target : target;
+    if (level * gain > ceiling)
+      target = m_Settings.bRMSDetection ? m_Ceiling / sqrtf(level) : m_Ceiling / level;
+
+    /* release smoothing, attack is handled by the look-ahead below */
+    if (target < m_LimiterGain)
+      m_LimiterGain = target;
+    else
+      m_LimiterGain = target + m_LimiterRelease * (m_LimiterGain - target);
+
+    /* min-hold over latency + 1 samples */
+    while (m_HoldCount > 0 && m_HoldValue[(m_HoldHead + m_HoldCount - 1) % holdSize] >= m_LimiterGain)
+      --m_HoldCount;
+    m_HoldValue[(m_HoldHead + m_HoldCount) % holdSize] = m_LimiterGain;
+    m_HoldIndex[(m_HoldHead + m_HoldCount) % holdSize] = m_Position;
+    ++m_HoldCount;
+    if (m_Position - m_HoldIndex[m_HoldHead] >= holdSize)
+    {
+      m_HoldHead = (m_HoldHead + 1) % holdSize;
+      --m_HoldCount;
+    }
+    ++m_Position;
+
+    /* box smoothing over latency samples, gives the attack ramp */
+    float hold = m_HoldValue[m_HoldHead];
+    m_SmoothSum += hold - m_Smooth[m_SmoothPtr];
+    m_Smooth[m_SmoothPtr] = hold;
+    if (++m_SmoothPtr >= m_Latency)
+      m_SmoothPtr = 0;
+
+    m_Gain[pos] = (float)(m_SmoothSum / m_Latency);
+  }
+}
+
+void CCompressor::Process(float **array, unsigned int samples)
+{
+  /* the block buffers are sized on Init, a larger block is done in parts */
+  for (unsigned int offset = 0; offset < samples; offset += m_Detector.size())
+  {
+    unsigned int length = samples - offset;
+    if (length > m_Detector.size())
+      length = m_Detector.size();
+
+    Detect(array, offset, length);
+    ComputeGain(length);
+
+    const float *gain = &m_Gain[0];
+    for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+    {
+      if (m_LookAhead[i] == NULL)
+        continue;
+
+      float *data = array[i] + offset;
+      for (unsigned int pos = 0; pos < length; ++pos)
+      {
+        m_LookAhead[i]->Store(data[pos]);
+        data[pos] = (float)m_LookAhead[i]->Retrieve() * gain[pos];
+      }
+    }
+  }
+}
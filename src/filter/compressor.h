@@ -0,0 +1,103 @@
+#pragma once
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Multichannel linked compressor with a look-ahead brickwall limiter.
+ *
+ * All channels share one detector and one gain curve, so the stereo and
+ * surround image does not move when only a single channel gets loud.
+ * The look-ahead is done with one CDelay per channel, the limiter gain is
+ * min-hold filtered and box smoothed over the look-ahead window, so the gain
+ * is already down when the peak leaves the delay line.
+ */
+
+#include <vector>
+
+#include "kodi_adsp_types.h"
+#include "delay.h"
+
+#define DYNAMIC_RANGE_OFF               0   //!< Only the static soft clamp is used
+#define DYNAMIC_RANGE_LIMITER           1   //!< Brickwall limiter only
+#define DYNAMIC_RANGE_NIGHT_MODE        2   //!< Compressor followed by the brickwall limiter
+
+#define COMPRESSOR_LOOKAHEAD            mSEC_TO_DELAY(2)  //!< Look-ahead time in DELAY_RESOLUTION
+#define COMPRESSOR_CEILING_DB           -0.3f             //!< Limiter ceiling in dBFS
+#define COMPRESSOR_LIMITER_RELEASE      60.0f             //!< Limiter release time in ms
+#define COMPRESSOR_MAKEUP_PART          0.5f              //!< Part of the gain reduction at 0 dBFS which is given back as makeup gain
+#define COMPRESSOR_TAIL_RELEASES        14.0f             //!< Release time constants until the gain is settled to -120 dB
+
+struct sCompressorSettings
+{
+  bool  bCompress;          //!< Compressor enabled, otherwise only the limiter is active
+  bool  bRMSDetection;      //!< Use RMS detection, otherwise peak detection
+  float fThreshold;         //!< Compressor threshold in dBFS
+  float fRatio;             //!< Compression ratio (x:1)
+  float fAttack;            //!< Attack time in ms
+  float fRelease;           //!< Release time in ms
+};
+
+class CCompressor
+{
+public:
+  CCompressor();
+  ~CCompressor();
+
+  void Init(unsigned long channelPresentFlags, unsigned int samplingRate, unsigned int maxSamples);
+  void SetParameters(const sCompressorSettings &settings);
+  void Process(float **array, unsigned int samples);
+  void Flush();
+
+  unsigned int GetLatency() const;  //!< Return number of samples
+  unsigned int GetTailLength() const; //!< Samples until output and gain are settled after silent input
+
+private:
+  void Detect(float **array, unsigned int offset, unsigned int samples);
+  void ComputeGain(unsigned int samples);
+
+  CDelay               *m_LookAhead[AE_DSP_CH_MAX];
+  unsigned long         m_ChannelPresentFlags;
+  unsigned int          m_SamplingRate;
+  unsigned int          m_Latency;
+
+  sCompressorSettings   m_Settings;
+  float                 m_Threshold;      //!< Linear threshold (squared for RMS detection)
+  float                 m_Exponent;       //!< Gain computer exponent (1/ratio - 1)
+  float                 m_Makeup;         //!< Linear makeup gain
+  float                 m_Ceiling;        //!< Linear limiter ceiling
+  float                 m_AttackCoeff;
+  float                 m_ReleaseCoeff;
+  float                 m_LimiterRelease;
+
+  float                 m_Envelope;       //!< Detector envelope
+  float                 m_LimiterGain;    //!< Release smoothed limiter target
+
+  std::vector<float>    m_Detector;       //!< Linked detector level of the current block
+  std::vector<float>    m_Gain;           //!< Gain curve of the current block
+
+  std::vector<float>    m_HoldValue;      //!< Min-hold deque values, ring with size latency + 1
+  std::vector<unsigned int> m_HoldIndex;  //!< Min-hold deque sample positions
+  unsigned int          m_HoldHead;
+  unsigned int          m_HoldCount;
+  unsigned int          m_Position;
+
+  std::vector<float>    m_Smooth;         //!< Box filter history, ring with size latency
+  unsigned int          m_SmoothPtr;
+  double                m_SmoothSum;
+};
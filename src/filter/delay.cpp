@@ -21,48 +21,140 @@
  * http://sourceforge.net/projects/xover/
  */
 
-#include "../AudioDSPBasic.h"
-#include "delay.h"
+#include <stddef.h>
 
-#define CURRENT_DEPTH ((m_in >= m_out) ? m_in-m_out : m_Size - (m_out-m_in))
-#define BUFFER_INCREASED_TIME 1000
+#include "delay.h"
 
-CDelay::CDelay(void)
+template <typename SAMPLE>
+CDelayT<SAMPLE>::CDelayT(void)
 {
-  m_Buffer      = NULL;
-  m_BufferSize  = 0;
+  m_Buffer        = NULL;
+  m_BufferSize    = 0;
+  m_Mask          = 0;
+  m_Write         = 0;
+  m_Size          = 0;
+  m_SamplingRate  = 0;
+  m_Delay         = 0;
+  m_Padding       = 0;
 }
 
-CDelay::~CDelay(void)
+template <typename SAMPLE>
+CDelayT<SAMPLE>::~CDelayT(void)
 {
   if (m_Buffer != NULL)
   {
-    delete m_Buffer;
+    delete[] m_Buffer;
   }
 }
 
-void CDelay::Init(unsigned int delay, unsigned sampling_rate)
+template <typename SAMPLE>
+void CDelayT<SAMPLE>::Init(unsigned int delay, unsigned sampling_rate)
 {
   m_Delay         = delay;
   m_SamplingRate  = sampling_rate;
-  m_Size          = (unsigned int)(double(m_Delay)/DELAY_RESOLUTION*m_SamplingRate);
 
-  if (m_Size > m_BufferSize)
-  {
-    m_BufferSize = (unsigned int)(double(m_Delay+BUFFER_INCREASED_TIME)/DELAY_RESOLUTION*m_SamplingRate);
-    if (m_Buffer != NULL)
-      delete m_Buffer;
+  UpdateSize();
+  Flush();
+}
 
-    m_Buffer = new double[m_BufferSize+1];
-  }
+template <typename SAMPLE>
+void CDelayT<SAMPLE>::UpdateSize(void)
+{
+  m_Size = (unsigned int)(double(m_Delay)/DELAY_RESOLUTION*m_SamplingRate) + m_Padding;
+  Grow(m_Size);
+}
+
+template <typename SAMPLE>
+unsigned int CDelayT<SAMPLE>::GetRingSize(unsigned int size)
+{
+  /* the read position may go back up to size samples behind the sample
+   * stored last */
+  if (size < m_BufferSize)
+    return m_BufferSize;
+
+  unsigned int bufferSize = m_BufferSize > 0 ? m_BufferSize : 64;
+  while (bufferSize <= size)
+    bufferSize *= 2;
+  return bufferSize;
+}
+
+template <typename SAMPLE>
+void CDelayT<SAMPLE>::Grow(unsigned int size)
+{
+  unsigned int bufferSize = GetRingSize(size);
+  if (bufferSize == m_BufferSize)
+    return;
 
-  m_in  = m_Buffer;
-  m_out = m_Buffer;
+  SAMPLE *buffer = new SAMPLE[bufferSize];
+  for (unsigned int i = m_BufferSize; i < bufferSize; ++i)
+    buffer[i] = 0.0;
 
-  m_DataReady = false;
+  SAMPLE *previous = SwapRing(buffer, bufferSize);
+  if (previous != NULL)
+    delete[] previous;
 }
 
-void CDelay::SetSamplingRate(unsigned int sampling_rate)
+template <typename SAMPLE>
+SAMPLE *CDelayT<SAMPLE>::SwapRing(SAMPLE *buffer, unsigned int bufferSize)
+{
+  /* the stored samples are moved in their order, oldest first */
+  for (unsigned int i = 0; i < m_BufferSize; ++i)
+    buffer[i] = m_Buffer[(m_Write + i) & m_Mask];
+
+  SAMPLE *previous = m_Buffer;
+  m_Buffer      = buffer;
+  m_Write       = m_BufferSize;
+  m_BufferSize  = bufferSize;
+  m_Mask        = bufferSize - 1;
+  return previous;
+}
+
+template <typename SAMPLE>
+bool CDelayT<SAMPLE>::BeginGrow(unsigned int delay, sGrow &grow)
+{
+  unsigned int size = (unsigned int)(double(delay)/DELAY_RESOLUTION*m_SamplingRate) + m_Padding;
+  unsigned int bufferSize = GetRingSize(size);
+
+  grow.pBuffer      = NULL;
+  grow.iBufferSize  = bufferSize != m_BufferSize ? bufferSize : 0;
+  return grow.iBufferSize > 0;
+}
+
+template <typename SAMPLE>
+void CDelayT<SAMPLE>::PrepareGrow(sGrow &grow)
+{
+  if (grow.iBufferSize == 0)
+    return;
+
+  /* only the new ring is touched here, the line can change or be deleted
+   * until CommitGrow */
+  SAMPLE *buffer = new SAMPLE[grow.iBufferSize];
+  for (unsigned int i = 0; i < grow.iBufferSize; ++i)
+    buffer[i] = 0.0;
+  grow.pBuffer = buffer;
+}
+
+template <typename SAMPLE>
+SAMPLE *CDelayT<SAMPLE>::CommitGrow(sGrow &grow)
+{
+  if (grow.pBuffer == NULL)
+    return NULL;
+
+  /* the line was grown in between, the prepared ring is dropped */
+  if (grow.iBufferSize <= m_BufferSize)
+  {
+    SAMPLE *unused = grow.pBuffer;
+    grow.pBuffer = NULL;
+    return unused;
+  }
+
+  SAMPLE *previous = SwapRing(grow.pBuffer, grow.iBufferSize);
+  grow.pBuffer = NULL;
+  return previous;
+}
+
+template <typename SAMPLE>
+void CDelayT<SAMPLE>::SetSamplingRate(unsigned int sampling_rate)
 {
   if (sampling_rate != m_SamplingRate)
   {
@@ -70,68 +162,88 @@ void CDelay::SetSamplingRate(unsigned int sampling_rate)
   }
 }
 
-void CDelay::SetDelay(unsigned int delay)
+template <typename SAMPLE>
+void CDelayT<SAMPLE>::SetDelay(unsigned int delay)
 {
   if (delay != m_Delay)
   {
-    Init(delay, m_SamplingRate);
+    /* only the read position moves, the audio in the line is kept */
+    m_Delay = delay;
+    UpdateSize();
+  }
+}
+
+template <typename SAMPLE>
+void CDelayT<SAMPLE>::SetPadding(unsigned int samples)
+{
+  if (samples != m_Padding)
+  {
+    m_Padding = samples;
+    UpdateSize();
   }
 }
 
-unsigned int CDelay::GetDelay(void)
+template <typename SAMPLE>
+void CDelayT<SAMPLE>::Reserve(unsigned int delay)
+{
+  /* a later SetDelay up to this delay only moves the read position */
+  Grow((unsigned int)(double(delay)/DELAY_RESOLUTION*m_SamplingRate) + m_Padding);
+}
+
+template <typename SAMPLE>
+unsigned int CDelayT<SAMPLE>::GetDelay(void)
 {
   return m_Delay;
 }
 
-unsigned int CDelay::GetLatency(void)
+template <typename SAMPLE>
+unsigned int CDelayT<SAMPLE>::GetLatency(void)
 {
   return m_Size;
 }
 
-unsigned int CDelay::GetSamplingRate(void)
+template <typename SAMPLE>
+unsigned int CDelayT<SAMPLE>::GetPadding(void)
+{
+  return m_Padding;
+}
+
+template <typename SAMPLE>
+unsigned int CDelayT<SAMPLE>::GetSamplingRate(void)
 {
   return m_SamplingRate;
 }
 
-void CDelay::Store(double input)
+template <typename SAMPLE>
+void CDelayT<SAMPLE>::Store(SAMPLE input)
 {
   if (m_Buffer != NULL)
   {
-    *m_in++ = input;
-
-     // wrap input buffer pointer
-    if (m_in >= m_Buffer + m_Size)
-    {
-      m_in = m_Buffer;
-      m_DataReady = true;
-    }
+    m_Buffer[m_Write & m_Mask] = input;
+    ++m_Write;
   }
 }
 
-double CDelay::Retrieve(void)
+template <typename SAMPLE>
+SAMPLE CDelayT<SAMPLE>::Retrieve(void)
 {
-  double data_out;
+  if (m_Buffer == NULL)
+    return 0.0;
 
-  if ((m_Buffer != NULL) && m_DataReady)
-  {
-    data_out = *m_out++;
+  /* the sample stored m_Size calls before the last Store */
+  return m_Buffer[(m_Write - 1 - m_Size) & m_Mask];
+}
 
-    // wrap output buffer pointer
-    if (m_out >= (m_Buffer+m_Size))
-    {
-      m_out = m_Buffer;
-    }
-  }
-  else
+template <typename SAMPLE>
+void CDelayT<SAMPLE>::Flush(void)
+{
+  if (m_Buffer != NULL)
   {
-    data_out = 0.0;
+    for (unsigned int i = 0; i < m_BufferSize; ++i)
+      m_Buffer[i] = 0.0;
   }
-  return data_out;
+  m_Write = 0;
 }
 
-void CDelay::Flush(void)
-{
-  m_in        = m_Buffer;
-  m_out       = m_Buffer;
-  m_DataReady = false;
-}
+template class CDelayT<float>;
+template class CDelayT<double>;
@@ -22,6 +22,8 @@
  * http://sourceforge.net/projects/xover/
  */
 
+#include "precision.h"
+
 const int DELAY_RESOLUTION  = 1000000;
 const int MAX_DELAY_SEC     = 1;
 const int MAX_DELAY         = MAX_DELAY_SEC * DELAY_RESOLUTION;
@@ -52,35 +54,59 @@ const int MAX_DELAY         = MAX_DELAY_SEC * DELAY_RESOLUTION;
 #define DELAY_TO_IN_FRAC(VAL)   ROUND(double(VAL)*SPEED_OF_SOUND*METER_TO_INCHES*100/DELAY_RESOLUTION)%100
 #define DELAY_TO_FT(VAL)        ROUND(double(VAL)*SPEED_OF_SOUND*METER_TO_FEETS*100/DELAY_RESOLUTION)
 
-class CDelay
+template <typename SAMPLE>
+class CDelayT
 {
 public:
-  CDelay(void);
-  ~CDelay(void);
+  CDelayT(void);
+  ~CDelayT(void);
 
   void Init(unsigned int delay, unsigned sampling_rate);
 
-  void Store(double input);
-  double Retrieve(void);
+  void Store(SAMPLE input);
+  SAMPLE Retrieve(void);
   void Flush(void);
 
   void SetSamplingRate(unsigned int sampling_rate); //!< in Hz
-  void SetDelay(unsigned int delay);                //!< defined in DELAY_RESOLUTION ( currently in uS)
+  void SetDelay(unsigned int delay);                //!< defined in DELAY_RESOLUTION ( currently in uS), keeps the stored samples
+  void SetPadding(unsigned int samples);            //!< Samples added to the delay to align with other channels
+  void Reserve(unsigned int delay);                 //!< Grows the ring to hold delay, the current delay is kept
 
   unsigned int GetSamplingRate(void);               //!< Return Hz
   unsigned int GetDelay(void);                      //!< Return in DELAY_RESOLUTION ( currently in uS)
-  unsigned int GetLatency(void);                    //!< Return number of samples
+  unsigned int GetLatency(void);                    //!< Return number of samples, padding included
+  unsigned int GetPadding(void);                    //!< Return number of samples
+
+  /*!
+   * A longer delay can need a larger ring. For a line used by another thread
+   * under a lock the ring is grown in three steps: BeginGrow and CommitGrow
+   * are called under that lock, PrepareGrow allocates the new ring without
+   * it and never reads the line. CommitGrow moves the stored samples over
+   * and returns the buffer to delete after the lock is released.
+   */
+  struct sGrow
+  {
+    SAMPLE       *pBuffer;                          //!< New ring from PrepareGrow
+    unsigned int  iBufferSize;                      //!< 0 if the ring is large enough
+  };
+  bool BeginGrow(unsigned int delay, sGrow &grow);
+  static void PrepareGrow(sGrow &grow);
+  SAMPLE *CommitGrow(sGrow &grow);
 
 private:
-  double       *m_Buffer;
-  double       *m_in;
-  double       *m_out;
+  void UpdateSize(void);
+  void Grow(unsigned int size);
+  SAMPLE *SwapRing(SAMPLE *buffer, unsigned int bufferSize); //!< Returns the previous ring
+  unsigned int GetRingSize(unsigned int size);
 
-  unsigned int  m_Size;
-  unsigned int  m_BufferSize;
+  SAMPLE       *m_Buffer;                           //!< Ring of the last m_BufferSize stored samples
+  unsigned int  m_BufferSize;                       //!< Power of two
+  unsigned int  m_Mask;
+  unsigned int  m_Write;                            //!< Count of stored samples, the ring position is masked
+
+  unsigned int  m_Size;                             //!< Latency in samples, distance of the read to the write position
   unsigned int  m_SamplingRate;
 
   unsigned int  m_Delay;
-
-  bool          m_DataReady;
+  unsigned int  m_Padding;
 };
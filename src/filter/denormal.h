@@ -0,0 +1,87 @@
+#pragma once
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Protection against denormal numbers.
+ *
+ * Recursive filters decay towards zero on silent input and end up in the
+ * denormal range, where x86 CPUs need many times the cycles per operation.
+ * CDenormalGuard switches the FPU of the calling thread to flush such
+ * results to zero for the lifetime of the object, on x86 with FTZ and DAZ,
+ * on ARM with the FZ bit. The feedback paths also add DENORMAL_OFFSET with
+ * alternating sign, which covers platforms without these controls. It keeps
+ * the state out of the denormal range and is far below the output
+ * resolution.
+ */
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+  #include <xmmintrin.h>
+  #define DENORMAL_SSE
+  #define DENORMAL_MXCSR_FTZ        0x8000
+  #define DENORMAL_MXCSR_DAZ        0x0040
+#elif defined(__aarch64__) || (defined(__arm__) && defined(__VFP_FP__) && !defined(__SOFTFP__))
+  #define DENORMAL_ARM
+  #define DENORMAL_ARM_FZ           (1 << 24)
+#endif
+
+#define DENORMAL_OFFSET             1e-18f    //!< About -360 dBFS
+
+class CDenormalGuard
+{
+public:
+  CDenormalGuard()
+  {
+#if defined(DENORMAL_SSE)
+    m_Saved = _mm_getcsr();
+    _mm_setcsr(m_Saved | DENORMAL_MXCSR_FTZ | DENORMAL_MXCSR_DAZ);
+#elif defined(DENORMAL_ARM)
+    m_Saved = GetControl();
+    SetControl(m_Saved | DENORMAL_ARM_FZ);
+#endif
+  }
+
+  ~CDenormalGuard()
+  {
+#if defined(DENORMAL_SSE)
+    _mm_setcsr(m_Saved);
+#elif defined(DENORMAL_ARM)
+    SetControl(m_Saved);
+#endif
+  }
+
+private:
+#if defined(DENORMAL_ARM)
+  #if defined(__aarch64__)
+  typedef unsigned long long ControlType;
+  static inline ControlType GetControl() { ControlType value; __asm__ __volatile__("mrs %0, fpcr" : "=r"(value)); return value; }
+  static inline void SetControl(ControlType value) { __asm__ __volatile__("msr fpcr, %0" : : "r"(value)); }
+  #else
+  typedef unsigned int ControlType;
+  static inline ControlType GetControl() { ControlType value; __asm__ __volatile__("vmrs %0, fpscr" : "=r"(value)); return value; }
+  static inline void SetControl(ControlType value) { __asm__ __volatile__("vmsr fpscr, %0" : : "r"(value)); }
+  #endif
+  ControlType   m_Saved;
+#elif defined(DENORMAL_SSE)
+  unsigned int  m_Saved;
+#endif
+
+  CDenormalGuard(const CDenormalGuard &);
+  CDenormalGuard &operator=(const CDenormalGuard &);
+};
@@ -0,0 +1,250 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "dialogue.h"
+#include "denormal.h"
+#include "../Process_Stereo/DSPProcessStereo.h"
+
+#if !defined(M_PI) && defined(TARGET_WINDOWS)
+  #define _USE_MATH_DEFINES
+  #include <cmath>
+#endif
+
+CDialogueEnhancer::CDialogueEnhancer()
+  : m_ChannelPresentFlags(0)
+  , m_SamplingRate(0)
+  , m_HasCenter(false)
+  , m_OtherChannels(0)
+  , m_Boost(1.0f)
+  , m_Duck(1.0f)
+  , m_Presence(0.0f)
+  , m_DuckGain(1.0f)
+  , m_BandGain(0.0f)
+{
+  memset(&m_HighPass, 0, sizeof(m_HighPass));
+  memset(&m_LowPass, 0, sizeof(m_LowPass));
+}
+
+CDialogueEnhancer::~CDialogueEnhancer()
+{
+}
+
+void CDialogueEnhancer::Init(unsigned long channelPresentFlags, unsigned int samplingRate, unsigned int maxSamples)
+{
+  m_ChannelPresentFlags = channelPresentFlags;
+  m_SamplingRate        = samplingRate;
+  m_HasCenter           = (channelPresentFlags & AE_DSP_PRSNT_CH_FC) != 0;
+
+  m_OtherChannels = 0;
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    if (i == AE_DSP_CH_FC || i == AE_DSP_CH_LFE || !(channelPresentFlags & (1 << i)))
+      continue;
+    ++m_OtherChannels;
+  }
+
+  DesignHighPass(m_HighPass, DIALOGUE_BAND_LOW, samplingRate);
+  DesignLowPass(m_LowPass, DIALOGUE_BAND_HIGH, samplingRate);
+
+  /* larger blocks are processed in parts of this size, see Process */
+  m_Band.resize(maxSamples > 0 ? maxSamples : 1);
+
+  m_Presence = 0.0f;
+  m_DuckGain = 1.0f;
+  m_BandGain = 0.0f;
+}
+
+void CDialogueEnhancer::SetParameters(float boost, float duck)
+{
+  m_Boost = boost;
+  m_Duck  = duck;
+}
+
+void CDialogueEnhancer::DesignHighPass(sBiquad &filter, float freq, unsigned int samplingRate)
+{
+  double w0     = 2.0 * M_PI * freq / samplingRate;
+  double alpha  = sin(w0) / (2.0 * M_SQRT1_2);
+  double cosw0  = cos(w0);
+  double a0     = 1.0 + alpha;
+
+  filter.b0 = (float)((1.0 + cosw0) / 2.0 / a0);
+  filter.b1 = (float)(-(1.0 + cosw0) / a0);
+  filter.b2 = filter.b0;
+  filter.a1 = (float)(-2.0 * cosw0 / a0);
+  filter.a2 = (float)((1.0 - alpha) / a0);
+  filter.z1 = 0.0f;
+  filter.z2 = 0.0f;
+}
+
+void CDialogueEnhancer::DesignLowPass(sBiquad &filter, float freq, unsigned int samplingRate)
+{
+  double w0     = 2.0 * M_PI * freq / samplingRate;
+  double alpha  = sin(w0) / (2.0 * M_SQRT1_2);
+  double cosw0  = cos(w0);
+  double a0     = 1.0 + alpha;
+
+  filter.b0 = (float)((1.0 - cosw0) / 2.0 / a0);
+  filter.b1 = (float)((1.0 - cosw0) / a0);
+  filter.b2 = filter.b0;
+  filter.a1 = (float)(-2.0 * cosw0 / a0);
+  filter.a2 = (float)((1.0 - alpha) / a0);
+  filter.z1 = 0.0f;
+  filter.z2 = 0.0f;
+}
+
+void CDialogueEnhancer::RunBiquad(sBiquad &filter, float *data, unsigned int samples)
+{
+  const float b0 = filter.b0, b1 = filter.b1, b2 = filter.b2, a1 = filter.a1, a2 = filter.a2;
+  float z1 = filter.z1;
+  float z2 = filter.z2;
+  float offset = DENORMAL_OFFSET;
+
+  for (unsigned int pos = 0; pos < samples; ++pos)
+  {
+    float x = data[pos];
+    float y = b0 * x + z1;
+    z1 = b1 * x - a1 * y + z2 + offset;
+    z2 = b2 * x - a2 * y;
+    data[pos] = y;
+    offset = -offset;
+  }
+
+  filter.z1 = z1;
+  filter.z2 = z2;
+}
+
+void CDialogueEnhancer::UpdatePresence(float **array, unsigned int offset, unsigned int samples)
+{
+  float *band = &m_Band[0];
+
+  /* Speech band of the center, for stereo streams the phantom center is
+   * taken with the same coefficient as the stereo downmix uses for FC. */
+  if (m_HasCenter)
+  {
+    memcpy(band, array[AE_DSP_CH_FC] + offset, samples * sizeof(float));
+  }
+  else
+  {
+    const float *l = array[AE_DSP_CH_FL] + offset;
+    const float *r = array[AE_DSP_CH_FR] + offset;
+    for (unsigned int pos = 0; pos < samples; ++pos)
+      band[pos] = (l[pos] + r[pos]) * (float)DM_CL;
+  }
+
+  float total = 0.0f;
+  for (unsigned int pos = 0; pos < samples; ++pos)
+    total += band[pos] * band[pos];
+
+  RunBiquad(m_HighPass, band, samples);
+  RunBiquad(m_LowPass, band, samples);
+
+  float speech = 0.0f;
+  for (unsigned int pos = 0; pos < samples; ++pos)
+    speech += band[pos] * band[pos];
+
+  float others = 0.0f;
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    if (i == AE_DSP_CH_FC || i == AE_DSP_CH_LFE || !(m_ChannelPresentFlags & (1 << i)))
+      continue;
+
+    const float *in = array[i] + offset;
+    for (unsigned int pos = 0; pos < samples; ++pos)
+      others += in[pos] * in[pos];
+  }
+  if (m_OtherChannels > 0)
+    others /= m_OtherChannels;
+
+  /* on stereo both sides carry the phantom center, only the band share counts */
+  bool present = speech > 1e-7f * samples && speech > DIALOGUE_BAND_RATIO * total;
+  if (m_HasCenter && m_OtherChannels > 0)
+    present = present && speech > DIALOGUE_DOMINANCE * others;
+
+  float time  = present ? DIALOGUE_ATTACK_TIME : DIALOGUE_RELEASE_TIME;
+  float coeff = expf(-(float)samples / (time * m_SamplingRate));
+  m_Presence  = (present ? 1.0f : 0.0f) + coeff * (m_Presence - (present ? 1.0f : 0.0f));
+}
+
+void CDialogueEnhancer::Process(float **array, unsigned int samples)
+{
+  if (samples == 0 || m_SamplingRate == 0)
+    return;
+
+  const unsigned long stereo = AE_DSP_PRSNT_CH_FL | AE_DSP_PRSNT_CH_FR;
+  if (!m_HasCenter && (m_ChannelPresentFlags & stereo) != stereo)
+    return;
+
+  /* the band buffer is sized on Init, a larger block is done in parts */
+  for (unsigned int offset = 0; offset < samples; offset += m_Band.size())
+  {
+    unsigned int length = samples - offset;
+    if (length > m_Band.size())
+      length = m_Band.size();
+    ProcessBlock(array, offset, length);
+  }
+}
+
+void CDialogueEnhancer::ProcessBlock(float **array, unsigned int offset, unsigned int samples)
+{
+  UpdatePresence(array, offset, samples);
+
+  /* block targets, the per sample work is a linear ramp towards them */
+  float bandTarget = (m_Boost - 1.0f) * m_Presence;
+  float duckTarget = 1.0f + (m_Duck - 1.0f) * m_Presence;
+  float step       = 1.0f / samples;
+
+  const float *band = &m_Band[0];
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    if (!(m_ChannelPresentFlags & (1 << i)) || i == AE_DSP_CH_LFE)
+      continue;
+
+    float *data = array[i] + offset;
+    bool center = m_HasCenter ? i == AE_DSP_CH_FC : (i == AE_DSP_CH_FL || i == AE_DSP_CH_FR);
+    if (center)
+    {
+      /* the phantom band is (FL + FR) * DM_CL, scaled back by DM_CL each
+       * side gets the lift of its own share of the center */
+      float scale = m_HasCenter ? 1.0f : (float)DM_CL;
+      float gain  = m_BandGain * scale;
+      float delta = (bandTarget - m_BandGain) * scale * step;
+      for (unsigned int pos = 0; pos < samples; ++pos)
+      {
+        gain += delta;
+        data[pos] += band[pos] * gain;
+      }
+    }
+    else if (m_HasCenter)
+    {
+      float gain  = m_DuckGain;
+      float delta = (duckTarget - m_DuckGain) * step;
+      for (unsigned int pos = 0; pos < samples; ++pos)
+      {
+        gain += delta;
+        data[pos] *= gain;
+      }
+    }
+  }
+
+  m_DuckGain = duckTarget;
+  m_BandGain = bandTarget;
+}
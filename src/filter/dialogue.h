@@ -0,0 +1,82 @@
+#pragma once
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Adaptive dialogue enhancement.
+ *
+ * Speech presence is decided once per block from the speech band energy of
+ * the center (or the phantom center of a stereo stream) against the other
+ * channels. While dialogue is present the speech band of the center is
+ * lifted and the other channels are ducked, gains are ramped across the block.
+ */
+
+#include <vector>
+
+#include "kodi_adsp_types.h"
+
+#define DIALOGUE_BAND_LOW           300.0f    //!< Speech band lower edge in Hz
+#define DIALOGUE_BAND_HIGH          4000.0f   //!< Speech band upper edge in Hz
+#define DIALOGUE_ATTACK_TIME        0.05f     //!< Presence attack in seconds
+#define DIALOGUE_RELEASE_TIME       0.5f      //!< Presence release in seconds
+#define DIALOGUE_BAND_RATIO         0.5f      //!< Minimum share of center energy inside the speech band
+#define DIALOGUE_DOMINANCE          0.7f      //!< Minimum center band energy against the mean of the other channels
+
+class CDialogueEnhancer
+{
+public:
+  CDialogueEnhancer();
+  ~CDialogueEnhancer();
+
+  void Init(unsigned long channelPresentFlags, unsigned int samplingRate, unsigned int maxSamples);
+  void SetParameters(float boost, float duck);   //!< Linear coefficients as in cDSPProcessor::m_OutputGain
+  void Process(float **array, unsigned int samples);
+
+  float GetPresence() const { return m_Presence; }
+  bool IsUnity() const { return m_Boost == 1.0f && m_Duck == 1.0f; }
+
+private:
+  struct sBiquad
+  {
+    float b0, b1, b2, a1, a2;
+    float z1, z2;
+  };
+
+  static void DesignHighPass(sBiquad &filter, float freq, unsigned int samplingRate);
+  static void DesignLowPass(sBiquad &filter, float freq, unsigned int samplingRate);
+  static void RunBiquad(sBiquad &filter, float *data, unsigned int samples);
+
+  void UpdatePresence(float **array, unsigned int offset, unsigned int samples);
+  void ProcessBlock(float **array, unsigned int offset, unsigned int samples);
+
+  unsigned long       m_ChannelPresentFlags;
+  unsigned int        m_SamplingRate;
+  bool                m_HasCenter;        //!< Center present, otherwise the phantom center of FL/FR is used
+  unsigned int        m_OtherChannels;    //!< Amount of channels used for comparison
+
+  sBiquad             m_HighPass;
+  sBiquad             m_LowPass;
+  std::vector<float>  m_Band;             //!< Speech band of the center for the current block, sized on Init
+
+  float               m_Boost;            //!< Linear gain added to the speech band at full presence
+  float               m_Duck;             //!< Linear gain of the other channels at full presence
+  float               m_Presence;         //!< Smoothed speech presence, 0 to 1
+  float               m_DuckGain;         //!< Current coefficient of the other channels
+  float               m_BandGain;         //!< Current speech band lift coefficient
+};
@@ -0,0 +1,135 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include <math.h>
+
+#include "fft.h"
+
+#if !defined(M_PI) && defined(TARGET_WINDOWS)
+  #define _USE_MATH_DEFINES
+  #include <cmath>
+#endif
+
+CFFT::CFFT()
+  : m_Size(0)
+{
+}
+
+CFFT::~CFFT()
+{
+}
+
+unsigned int CFFT::NextPowerOfTwo(unsigned int value)
+{
+  unsigned int size = 1;
+  while (size < value)
+    size <<= 1;
+  return size;
+}
+
+bool CFFT::Init(unsigned int size)
+{
+  if (size < 2 || (size & (size - 1)) != 0)
+    return false;
+
+  if (size == m_Size)
+    return true;
+
+  m_Size = size;
+
+  unsigned int bits = 0;
+  while ((1u << bits) < size)
+    ++bits;
+
+  m_BitReverse.resize(size);
+  for (unsigned int i = 0; i < size; ++i)
+  {
+    unsigned int reversed = 0;
+    for (unsigned int b = 0; b < bits; ++b)
+    {
+      if (i & (1u << b))
+        reversed |= 1u << (bits - 1 - b);
+    }
+    m_BitReverse[i] = reversed;
+  }
+
+  m_Cos.resize(size / 2);
+  m_Sin.resize(size / 2);
+  for (unsigned int i = 0; i < size / 2; ++i)
+  {
+    m_Cos[i] = cos(2.0 * M_PI * i / size);
+    m_Sin[i] = sin(2.0 * M_PI * i / size);
+  }
+
+  return true;
+}
+
+void CFFT::Forward(double *re, double *im)
+{
+  Transform(re, im, false);
+}
+
+void CFFT::Inverse(double *re, double *im)
+{
+  Transform(re, im, true);
+
+  const double scale = 1.0 / m_Size;
+  for (unsigned int i = 0; i < m_Size; ++i)
+  {
+    re[i] *= scale;
+    im[i] *= scale;
+  }
+}
+
+void CFFT::Transform(double *re, double *im, bool inverse)
+{
+  for (unsigned int i = 0; i < m_Size; ++i)
+  {
+    unsigned int j = m_BitReverse[i];
+    if (j > i)
+    {
+      double t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+
+  const double sign = inverse ? 1.0 : -1.0;
+  for (unsigned int length = 2; length <= m_Size; length <<= 1)
+  {
+    unsigned int half = length / 2;
+    unsigned int step = m_Size / length;
+    for (unsigned int start = 0; start < m_Size; start += length)
+    {
+      for (unsigned int k = 0; k < half; ++k)
+      {
+        double wr = m_Cos[k * step];
+        double wi = sign * m_Sin[k * step];
+
+        unsigned int a = start + k;
+        unsigned int b = a + half;
+        double tr = re[b] * wr - im[b] * wi;
+        double ti = re[b] * wi + im[b] * wr;
+        re[b] = re[a] - tr;
+        im[b] = im[a] - ti;
+        re[a] += tr;
+        im[a] += ti;
+      }
+    }
+  }
+}
@@ -0,0 +1,49 @@
+#pragma once
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * In place radix 2 complex FFT on split real and imaginary arrays.
+ * Twiddle factors and the bit reversal table are built once by Init().
+ */
+
+#include <vector>
+
+class CFFT
+{
+public:
+  CFFT();
+  ~CFFT();
+
+  bool Init(unsigned int size);                   //!< size must be a power of two
+  unsigned int GetSize() const { return m_Size; }
+
+  void Forward(double *re, double *im);
+  void Inverse(double *re, double *im);           //!< Scaled by 1/size
+
+  static unsigned int NextPowerOfTwo(unsigned int value);
+
+private:
+  void Transform(double *re, double *im, bool inverse);
+
+  unsigned int                m_Size;
+  std::vector<unsigned int>   m_BitReverse;
+  std::vector<double>         m_Cos;
+  std::vector<double>         m_Sin;
+};
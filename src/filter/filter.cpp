@@ -5,10 +5,13 @@
 
 #include "mkfilter.h"
 #include "filter.h"
+#include "denormal.h"
 
-Cfilter::Cfilter()
+template <typename SAMPLE>
+CfilterT<SAMPLE>::CfilterT()
 {
 	m_SwapIndex = 0;
+	m_DenormalOffset = DENORMAL_OFFSET;
 	m_Gain[m_SwapIndex] = 1.0;
 	r_NumZero[m_SwapIndex] = 0;
 	r_NumPole[m_SwapIndex] = 0;
@@ -16,12 +19,14 @@ Cfilter::Cfilter()
 	m_Y[m_SwapIndex][0] = 0.0;
 }
 
-Cfilter::~Cfilter()
+template <typename SAMPLE>
+CfilterT<SAMPLE>::~CfilterT()
 {
 }
 
 
-bool Cfilter::Config(unsigned int nzero, double *xcoeff, unsigned int npole, double *ycoeff, double gain)
+template <typename SAMPLE>
+bool CfilterT<SAMPLE>::Config(unsigned int nzero, double *xcoeff, unsigned int npole, double *ycoeff, double gain)
 {
 	unsigned int i;
 
@@ -54,32 +59,38 @@ bool Cfilter::Config(unsigned int nzero, double *xcoeff, unsigned int npole, dou
 	return 0;
 }
 
-double Cfilter::GetGain(void)
+template <typename SAMPLE>
+double CfilterT<SAMPLE>::GetGain(void)
 {
 	return m_Gain[m_SwapIndex];
 }
 
-unsigned int Cfilter::GetNZero(void)
+template <typename SAMPLE>
+unsigned int CfilterT<SAMPLE>::GetNZero(void)
 {
 	return r_NumZero[m_SwapIndex];
 }
 
-double * Cfilter::GetXCoeff(void)
+template <typename SAMPLE>
+double * CfilterT<SAMPLE>::GetXCoeff(void)
 {
 	return m_XCoeff[m_SwapIndex];
 }
 
-unsigned int Cfilter::GetNPole(void)
+template <typename SAMPLE>
+unsigned int CfilterT<SAMPLE>::GetNPole(void)
 {
 	return r_NumPole[m_SwapIndex];
 }
 
-double * Cfilter::GetYCoeff(void)
+template <typename SAMPLE>
+double * CfilterT<SAMPLE>::GetYCoeff(void)
 {
 	return m_YCoeff[m_SwapIndex];
 }
 
-double Cfilter::GetNext(double in)
+template <typename SAMPLE>
+SAMPLE CfilterT<SAMPLE>::GetNext(SAMPLE in)
 {
 	int i;
 	int SwapIndex = m_SwapIndex;
@@ -88,14 +99,14 @@ double Cfilter::GetNext(double in)
 	{
 		m_X[SwapIndex][i] = m_X[SwapIndex][i+1];
 	}
-	m_X[SwapIndex][r_NumZero[SwapIndex]] = in / m_Gain[SwapIndex];
+	m_X[SwapIndex][r_NumZero[SwapIndex]] = (SAMPLE)(in / m_Gain[SwapIndex]);
 	for(i=0 ; i<r_NumPole[SwapIndex] ; i++)
 	{
 		m_Y[SwapIndex][i] = m_Y[SwapIndex][i+1];
 	}
 
 	//double a = m_X[SwapIndex][r_NumZero[SwapIndex]];
-	double a = 0.0;
+	DSPAccumulator a = 0.0;
 	for (i=0; i<=r_NumZero[SwapIndex]; i++)
 	{
 		a += m_XCoeff[SwapIndex][i]*m_X[SwapIndex][i];
@@ -104,7 +115,24 @@ double Cfilter::GetNext(double in)
 	{
 		a += m_YCoeff[SwapIndex][i]*m_Y[SwapIndex][i];
 	}
+	a += m_DenormalOffset;
+	m_DenormalOffset = -m_DenormalOffset;
 	m_Y[SwapIndex][r_NumPole[SwapIndex]] = a;
 
-	return (a);
+	return (SAMPLE)(a);
 }
+
+template <typename SAMPLE>
+void CfilterT<SAMPLE>::Flush(void)
+{
+	int SwapIndex = m_SwapIndex;
+
+	for (int i=0 ; i<=MAXPZ ; i++)
+	{
+		m_X[SwapIndex][i] = 0.0;
+		m_Y[SwapIndex][i] = 0.0;
+	}
+}
+
+template class CfilterT<float>;
+template class CfilterT<double>;
@@ -13,7 +13,14 @@
 #define OUTPUT_GAIN_MIN (-40 * OUTPUT_GAIN_SCALE)
 #define OUTPUT_GAIN_MAX (20 * OUTPUT_GAIN_SCALE)
 
-class Cfilter
+#include "precision.h"
+
+/*
+ * The input history is kept in SAMPLE, the recursive output history and
+ * the coefficients stay double, see precision.h
+ */
+template <typename SAMPLE>
+class CfilterT
 {
 #define MAXSWAPBUFFER 2
 
@@ -22,15 +29,18 @@ private:
 	double m_Gain[MAXSWAPBUFFER];
 	int r_NumZero[MAXSWAPBUFFER];
 	int r_NumPole[MAXSWAPBUFFER];
-	double m_X[MAXSWAPBUFFER][MAXPZ+1], m_Y[MAXSWAPBUFFER][MAXPZ+1];
+	SAMPLE m_X[MAXSWAPBUFFER][MAXPZ+1];
+	DSPAccumulator m_Y[MAXSWAPBUFFER][MAXPZ+1];
+	DSPAccumulator m_DenormalOffset;
 	double m_XCoeff[MAXSWAPBUFFER][MAXPZ+1], m_YCoeff[MAXSWAPBUFFER][MAXPZ+1];
 
 public:
-	Cfilter();
-	~Cfilter();
+	CfilterT();
+	~CfilterT();
 
 	bool Config(unsigned int nzero, double *xcoeff, unsigned int npole, double *ycoeff, double pbgain);
-	double GetNext(double in);
+	SAMPLE GetNext(SAMPLE in);
+	void Flush(void);
 
 	double GetGain(void);
 	unsigned int GetNZero(void);
@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include "high_shelf.h"
+#include "denormal.h"
 
 #define MIN_FREQ              20
 #define MAX_FREQ           20000
@@ -65,13 +66,15 @@ void chighShelf::Run(unsigned long SampleCount, float *input, float *output) {
     a1 = 2.0 * (A - 1.0 - (A + 1.0) * iv_cos);
     a2 = A + 1.0 - (A - 1.0) * iv_cos - iv_beta * iv_sin;
     inv_a0 = 1.0 / a0;
+    double offset = DENORMAL_OFFSET;
     for (unsigned i = 0; i < SampleCount; i++) {
         buf[1] = buf[0];
         buf[0] = input[i];
         buf[3] = buf[2];
         output[i] = inv_a0 * (gain * (b0 * input[i] + b1 * buf[0] + b2 * buf[1])
-                             - a1 * buf[2] - a2 * buf[3]);
+                             - a1 * buf[2] - a2 * buf[3]) + offset;
         buf[2] = output[i];
+        offset = -offset;
     }
     return;
 }
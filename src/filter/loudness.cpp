@@ -0,0 +1,282 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "loudness.h"
+#include "denormal.h"
+
+#if !defined(M_PI) && defined(TARGET_WINDOWS)
+  #define _USE_MATH_DEFINES
+  #include <cmath>
+#endif
+
+/* Channel weighting of ITU-R BS.1770, +1.5 dB for the surround channels, LFE excluded */
+static float ChannelWeight(int channel)
+{
+  switch (channel)
+  {
+    case AE_DSP_CH_LFE:
+      return 0.0f;
+    case AE_DSP_CH_BL:
+    case AE_DSP_CH_BR:
+    case AE_DSP_CH_BC:
+    case AE_DSP_CH_SL:
+    case AE_DSP_CH_SR:
+    case AE_DSP_CH_BLOC:
+    case AE_DSP_CH_BROC:
+      return 1.41f;
+    default:
+      return 1.0f;
+  }
+}
+
+static inline float PowerToLUFS(double power)
+{
+  return power > 0.0 ? (float)(-0.691 + 10.0 * log10(power)) : LOUDNESS_UNKNOWN;
+}
+
+CLoudnessMeter::CLoudnessMeter()
+  : m_SamplingRate(0)
+  , m_StepSize(1)
+  , m_Groups(0)
+{
+  Reset();
+}
+
+CLoudnessMeter::~CLoudnessMeter()
+{
+}
+
+void CLoudnessMeter::Init(unsigned long channelPresentFlags, unsigned int samplingRate)
+{
+  m_SamplingRate  = samplingRate;
+  m_StepSize      = samplingRate * LOUDNESS_STEP_MS / 1000;
+  if (m_StepSize == 0)
+    m_StepSize = 1;
+
+  /* K-weighting coefficients for the current sample rate, see ITU-R BS.1770 annex 1 */
+  double f0 = 1681.974450955533;
+  double G  = 3.999843853973347;
+  double Q  = 0.7071752369554196;
+  double K  = tan(M_PI * f0 / samplingRate);
+  double Vh = pow(10.0, G / 20.0);
+  double Vb = pow(Vh, 0.4996667741545416);
+  double a0 = 1.0 + K / Q + K * K;
+  m_Shelf.b0 = (float)((Vh + Vb * K / Q + K * K) / a0);
+  m_Shelf.b1 = (float)(2.0 * (K * K - Vh) / a0);
+  m_Shelf.b2 = (float)((Vh - Vb * K / Q + K * K) / a0);
+  m_Shelf.a1 = (float)(2.0 * (K * K - 1.0) / a0);
+  m_Shelf.a2 = (float)((1.0 - K / Q + K * K) / a0);
+
+  f0 = 38.13547087602444;
+  Q  = 0.5003270373238773;
+  K  = tan(M_PI * f0 / samplingRate);
+  a0 = 1.0 + K / Q + K * K;
+  m_HighPass.b0 = 1.0f;
+  m_HighPass.b1 = -2.0f;
+  m_HighPass.b2 = 1.0f;
+  m_HighPass.a1 = (float)(2.0 * (K * K - 1.0) / a0);
+  m_HighPass.a2 = (float)((1.0 - K / Q + K * K) / a0);
+
+  m_Channels.clear();
+  m_Weight.clear();
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    if ((channelPresentFlags & (1 << i)) && ChannelWeight(i) > 0.0f)
+    {
+      m_Channels.push_back(i);
+      m_Weight.push_back(ChannelWeight(i));
+    }
+  }
+
+  /* pad the last group with silent lanes which reuse the first channel */
+  m_Groups = (m_Channels.size() + LOUDNESS_LANES - 1) / LOUDNESS_LANES;
+  while (m_Channels.size() < m_Groups * LOUDNESS_LANES)
+  {
+    m_Channels.push_back(m_Channels[0]);
+    m_Weight.push_back(0.0f);
+  }
+
+  m_State.assign(m_Groups * LOUDNESS_LANES * 4, 0.0f);
+  m_Energy.assign(m_Groups * LOUDNESS_LANES, 0.0);
+  m_History.assign(LOUDNESS_HISTORY_BLOCKS, 0.0);
+
+  Reset();
+}
+
+void CLoudnessMeter::Reset()
+{
+  m_StepPos     = 0;
+  m_StepCount   = 0;
+  m_HistoryPtr  = 0;
+  m_BlockCount  = 0;
+  m_Momentary   = LOUDNESS_UNKNOWN;
+  m_Integrated  = LOUDNESS_UNKNOWN;
+
+  memset(m_Steps, 0, sizeof(m_Steps));
+  m_State.assign(m_State.size(), 0.0f);
+  m_Energy.assign(m_Energy.size(), 0.0);
+}
+
+void CLoudnessMeter::Process(const float **array_in, unsigned int samples)
+{
+  if (m_Groups == 0)
+    return;
+
+  unsigned int offset = 0;
+  while (offset < samples)
+  {
+    unsigned int length = m_StepSize - m_StepPos;
+    if (length > samples - offset)
+      length = samples - offset;
+
+    for (unsigned int group = 0; group < m_Groups; ++group)
+      ProcessGroup(group, array_in, offset, length);
+
+    offset    += length;
+    m_StepPos += length;
+    if (m_StepPos >= m_StepSize)
+      FinishStep();
+  }
+}
+
+void CLoudnessMeter::ProcessGroup(unsigned int group, const float **array_in, unsigned int offset, unsigned int samples)
+{
+  const float *in[LOUDNESS_LANES];
+  for (unsigned int lane = 0; lane < LOUDNESS_LANES; ++lane)
+    in[lane] = array_in[m_Channels[group * LOUDNESS_LANES + lane]] + offset;
+
+  float *state = &m_State[group * LOUDNESS_LANES * 4];
+  float s1z1[LOUDNESS_LANES], s1z2[LOUDNESS_LANES], s2z1[LOUDNESS_LANES], s2z2[LOUDNESS_LANES];
+  float energy[LOUDNESS_LANES];
+  for (unsigned int lane = 0; lane < LOUDNESS_LANES; ++lane)
+  {
+    s1z1[lane]    = state[lane];
+    s1z2[lane]    = state[LOUDNESS_LANES + lane];
+    s2z1[lane]    = state[LOUDNESS_LANES * 2 + lane];
+    s2z2[lane]    = state[LOUDNESS_LANES * 3 + lane];
+    energy[lane]  = 0.0f;
+  }
+
+  const sBiquad s1 = m_Shelf;
+  const sBiquad s2 = m_HighPass;
+
+  /* Both biquads in transposed direct form II, lanes are independent so the
+   * inner loop is one SIMD operation per coefficient. */
+  float antiDenormal = DENORMAL_OFFSET;
+  for (unsigned int pos = 0; pos < samples; ++pos)
+  {
+    float x[LOUDNESS_LANES];
+    for (unsigned int lane = 0; lane < LOUDNESS_LANES; ++lane)
+      x[lane] = in[lane][pos] + antiDenormal;
+    antiDenormal = -antiDenormal;
+
+    for (unsigned int lane = 0; lane < LOUDNESS_LANES; ++lane)
+    {
+      float y1    = s1.b0 * x[lane] + s1z1[lane];
+      s1z1[lane]  = s1.b1 * x[lane] - s1.a1 * y1 + s1z2[lane];
+      s1z2[lane]  = s1.b2 * x[lane] - s1.a2 * y1;
+
+      float y2    = s2.b0 * y1 + s2z1[lane];
+      s2z1[lane]  = s2.b1 * y1 - s2.a1 * y2 + s2z2[lane];
+      s2z2[lane]  = s2.b2 * y1 - s2.a2 * y2;
+
+      energy[lane] += y2 * y2;
+    }
+  }
+
+  for (unsigned int lane = 0; lane < LOUDNESS_LANES; ++lane)
+  {
+    state[lane]                       = s1z1[lane];
+    state[LOUDNESS_LANES + lane]      = s1z2[lane];
+    state[LOUDNESS_LANES * 2 + lane]  = s2z1[lane];
+    state[LOUDNESS_LANES * 3 + lane]  = s2z2[lane];
+    m_Energy[group * LOUDNESS_LANES + lane] += energy[lane];
+  }
+}
+
+void CLoudnessMeter::FinishStep()
+{
+  double power = 0.0;
+  for (unsigned int i = 0; i < m_Energy.size(); ++i)
+  {
+    power += m_Weight[i] * m_Energy[i];
+    m_Energy[i] = 0.0;
+  }
+
+  m_Steps[m_StepCount % LOUDNESS_STEPS_PER_BLOCK] = power / m_StepSize;
+  m_StepPos = 0;
+  if (++m_StepCount < LOUDNESS_STEPS_PER_BLOCK)
+    return;
+
+  /* 400 ms gating block out of the last four steps */
+  double block = 0.0;
+  for (unsigned int i = 0; i < LOUDNESS_STEPS_PER_BLOCK; ++i)
+    block += m_Steps[i];
+  block /= LOUDNESS_STEPS_PER_BLOCK;
+
+  m_Momentary = PowerToLUFS(block);
+
+  m_History[m_HistoryPtr] = block;
+  m_HistoryPtr = (m_HistoryPtr + 1) % LOUDNESS_HISTORY_BLOCKS;
+  ++m_BlockCount;
+
+  UpdateIntegrated();
+}
+
+void CLoudnessMeter::UpdateIntegrated()
+{
+  unsigned int blocks = m_BlockCount < LOUDNESS_HISTORY_BLOCKS ? m_BlockCount : LOUDNESS_HISTORY_BLOCKS;
+  const double absoluteGate = pow(10.0, (LOUDNESS_ABSOLUTE_GATE + 0.691) / 10.0);
+
+  double sum = 0.0;
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < blocks; ++i)
+  {
+    if (m_History[i] > absoluteGate)
+    {
+      sum += m_History[i];
+      ++count;
+    }
+  }
+  if (count == 0)
+  {
+    m_Integrated = LOUDNESS_UNKNOWN;
+    return;
+  }
+
+  double relativeGate = sum / count * pow(10.0, LOUDNESS_RELATIVE_GATE / 10.0);
+  if (relativeGate < absoluteGate)
+    relativeGate = absoluteGate;
+
+  sum   = 0.0;
+  count = 0;
+  for (unsigned int i = 0; i < blocks; ++i)
+  {
+    if (m_History[i] > relativeGate)
+    {
+      sum += m_History[i];
+      ++count;
+    }
+  }
+
+  m_Integrated = count > 0 ? PowerToLUFS(sum / count) : LOUDNESS_UNKNOWN;
+}
@@ -0,0 +1,88 @@
+#pragma once
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * ITU-R BS.1770 / EBU R128 loudness meter.
+ *
+ * Channels are K-weighted in groups of LOUDNESS_LANES, the biquad state of a
+ * group is kept side by side so the inner lane loop maps to one SIMD register.
+ * Loudness is gated on 400 ms blocks with 75% overlap, the integrated value
+ * covers the last LOUDNESS_HISTORY_BLOCKS blocks so it follows channel changes.
+ */
+
+#include <vector>
+
+#include "kodi_adsp_types.h"
+
+#define LOUDNESS_LANES                  4
+#define LOUDNESS_STEP_MS                100     //!< Gating block step (75% overlap of 400 ms)
+#define LOUDNESS_STEPS_PER_BLOCK        4
+#define LOUDNESS_HISTORY_BLOCKS         300     //!< 30 seconds of gating blocks
+#define LOUDNESS_ABSOLUTE_GATE          -70.0f  //!< LUFS
+#define LOUDNESS_RELATIVE_GATE          -10.0f  //!< LU
+#define LOUDNESS_UNKNOWN                -200.0f //!< Returned until the first block is gated
+
+class CLoudnessMeter
+{
+public:
+  CLoudnessMeter();
+  ~CLoudnessMeter();
+
+  void Init(unsigned long channelPresentFlags, unsigned int samplingRate);
+  void Reset();
+  void Process(const float **array_in, unsigned int samples);
+
+  float GetIntegratedLoudness() const { return m_Integrated; }   //!< Return LUFS
+  float GetMomentaryLoudness() const { return m_Momentary; }     //!< Return LUFS
+  unsigned int GetBlockCount() const { return m_BlockCount; }    //!< Return amount of gated blocks seen
+
+private:
+  struct sBiquad
+  {
+    float b0, b1, b2, a1, a2;
+  };
+
+  void ProcessGroup(unsigned int group, const float **array_in, unsigned int offset, unsigned int samples);
+  void FinishStep();
+  void UpdateIntegrated();
+
+  unsigned int          m_SamplingRate;
+  unsigned int          m_StepSize;         //!< Samples per gating step
+  unsigned int          m_StepPos;
+
+  sBiquad               m_Shelf;            //!< K-weighting stage 1, high shelf
+  sBiquad               m_HighPass;         //!< K-weighting stage 2, RLB high pass
+
+  unsigned int          m_Groups;
+  std::vector<int>      m_Channels;         //!< Dense channel list, the last group is padded with the first channel at weight 0
+  std::vector<float>    m_Weight;           //!< Channel weighting per lane
+  std::vector<float>    m_State;            //!< Biquad state, 4 values per lane, grouped
+  std::vector<double>   m_Energy;           //!< Sum of squares of the running step per lane
+
+  double                m_Steps[LOUDNESS_STEPS_PER_BLOCK];
+  unsigned int          m_StepCount;
+
+  std::vector<double>   m_History;          //!< Mean square of the last gating blocks
+  unsigned int          m_HistoryPtr;
+  unsigned int          m_BlockCount;
+
+  float                 m_Momentary;
+  float                 m_Integrated;
+};
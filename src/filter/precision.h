@@ -0,0 +1,42 @@
+#pragma once
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Compile time precision policy of the filter and delay classes.
+ *
+ * Samples kept in delay lines and filter histories are stored as DSPSample,
+ * float by default. Building with DSP_DOUBLE_PRECISION defined stores them
+ * as double. Recursive filter state, coefficients and sums are double in
+ * both cases, there a rounding error would be fed back into the output.
+ */
+
+#if defined(DSP_DOUBLE_PRECISION)
+typedef double DSPSample;
+#else
+typedef float DSPSample;
+#endif
+
+typedef double DSPAccumulator;
+
+template <typename SAMPLE> class CDelayT;
+template <typename SAMPLE> class CfilterT;
+
+typedef CDelayT<DSPSample>  CDelay;
+typedef CfilterT<DSPSample> Cfilter;
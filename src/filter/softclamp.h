@@ -0,0 +1,63 @@
+#pragma once
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Static soft clamp at the end of the post process, the signal passes
+ * unchanged up to SOFT_CLAMP_KNEE and bends over to full scale above.
+ */
+
+#include <math.h>
+
+#define SOFT_CLAMP_KNEE   0.9f    //!< Level where the clamp starts to bend
+
+inline float SoftClamp(float x)
+{
+#if 0
+  /*
+     This is a rational function to approximate a tanh-like soft clipper.
+     It is based on the pade-approximation of the tanh function with tweaked coefficients.
+     See: http://www.musicdsp.org/showone.php?id=238
+  */
+  if (x < -3.0f)
+    return -1.0f;
+  else if (x >  3.0f)
+    return 1.0f;
+  float y = x * x;
+  return x * (27.0f + y) / (27.0f + 9.0f * y);
+#else
+  /* slower method using tanh, but more accurate */
+
+  static const double k = SOFT_CLAMP_KNEE;
+  /* perform a soft clamp */
+  if (x >  k)
+    x = (float)(tanh((x - k) / (1 - k)) * (1 - k) + k);
+  else if (x < -k)
+    x = (float)(tanh((x + k) / (1 - k)) * (1 - k) - k);
+
+  /* hard clamp anything still outside the bounds */
+  if (x >  1.0f)
+    return  1.0f;
+  if (x < -1.0f)
+    return -1.0f;
+
+  /* return the final sample */
+  return x;
+#endif
+}
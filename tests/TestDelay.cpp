@@ -0,0 +1,223 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * CDelay holds the signal back by exactly GetLatency() samples, also when
+ * the delay or the padding change on a running line.
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "filter/delay.h"
+#include "PinkNoise.h"
+
+static unsigned int ImpulsePosition(CDelay &delay, unsigned int samples)
+{
+  for (unsigned int pos = 0; pos < samples; ++pos)
+  {
+    delay.Store(pos == 0 ? 1.0f : 0.0f);
+    if (delay.Retrieve() != 0.0f)
+      return pos;
+  }
+  return samples;
+}
+
+TEST(Delay, ImpulseArrivesAtLatency)
+{
+  const unsigned int rates[]  = { 44100, 48000, 96000, 192000 };
+  const unsigned int delays[] = { 0, mSEC_TO_DELAY(1), mSEC_TO_DELAY(10), M_TO_DELAY(3.5), mSEC_TO_DELAY(500) };
+
+  for (unsigned int r = 0; r < sizeof(rates) / sizeof(rates[0]); ++r)
+  {
+    for (unsigned int d = 0; d < sizeof(delays) / sizeof(delays[0]); ++d)
+    {
+      CDelay delay;
+      delay.Init(delays[d], rates[r]);
+      EXPECT_EQ(delay.GetLatency(), (unsigned int)(double(delays[d]) / DELAY_RESOLUTION * rates[r]));
+      EXPECT_EQ(ImpulsePosition(delay, rates[r]), delay.GetLatency())
+        << delays[d] << " us at " << rates[r] << " Hz";
+    }
+  }
+}
+
+TEST(Delay, MillisecondsToSamples)
+{
+  CDelay delay;
+  delay.Init(mSEC_TO_DELAY(10), 48000);
+  EXPECT_EQ(delay.GetLatency(), 480u);
+  EXPECT_EQ(delay.GetDelay(), (unsigned int)mSEC_TO_DELAY(10));
+}
+
+TEST(Delay, SetDelayKeepsStoredSamples)
+{
+  CDelay delay;
+  delay.Init(mSEC_TO_DELAY(1), 48000);
+
+  unsigned int pos = 0;
+  for (; pos < 1000; ++pos)
+  {
+    delay.Store((float)pos);
+    delay.Retrieve();
+  }
+
+  /* shorter, the read position moves forward over samples already stored */
+  delay.SetDelay(mSEC_TO_DELAY(0.5));
+  delay.Store((float)pos);
+  EXPECT_EQ(delay.Retrieve(), (float)(pos - delay.GetLatency()));
+  ++pos;
+
+  /* longer by several doublings of the ring. The samples the line still
+   * had to play come out in order, older ones were never kept and are
+   * silent */
+  unsigned int kept = pos - delay.GetLatency();
+  delay.SetDelay(mSEC_TO_DELAY(15));
+  for (unsigned int i = 0; i < 2000; ++i, ++pos)
+  {
+    delay.Store((float)pos);
+    float out = delay.Retrieve();
+    unsigned int source = pos - delay.GetLatency();
+    if (source >= kept)
+      ASSERT_EQ(out, (float)source) << "sample " << pos;
+    else
+      ASSERT_TRUE(out == 0.0f || out == (float)source) << "sample " << pos;
+  }
+}
+
+TEST(Delay, StagedGrowKeepsSamplesStoredMeanwhile)
+{
+  const unsigned int stored[] = { 0, 10, 100, 5000 };
+
+  for (unsigned int n = 0; n < sizeof(stored) / sizeof(stored[0]); ++n)
+  {
+    CDelay delay;
+    delay.Init(mSEC_TO_DELAY(1), 48000);
+
+    unsigned int pos = 0;
+    for (; pos < 1000; ++pos)
+      delay.Store((float)pos);
+
+    CDelay::sGrow grow;
+    ASSERT_TRUE(delay.BeginGrow(mSEC_TO_DELAY(15), grow));
+    CDelay::PrepareGrow(grow);
+
+    /* the audio thread goes on between the steps */
+    for (unsigned int i = 0; i < stored[n]; ++i, ++pos)
+      delay.Store((float)pos);
+
+    /* the ring of the 1 ms line holds the last 64 samples */
+    unsigned int kept = pos - 64;
+    delete[] delay.CommitGrow(grow);
+    delay.SetDelay(mSEC_TO_DELAY(15));
+
+    /* everything the old ring still held comes out in order */
+    for (unsigned int i = 0; i < 2000; ++i, ++pos)
+    {
+      delay.Store((float)pos);
+      float out = delay.Retrieve();
+      unsigned int source = pos - delay.GetLatency();
+      if (source >= kept)
+        ASSERT_EQ(out, (float)source) << "sample " << pos << " with " << stored[n] << " stored meanwhile";
+      else
+        ASSERT_TRUE(out == 0.0f || out == (float)source) << "sample " << pos << " with " << stored[n] << " stored meanwhile";
+    }
+  }
+}
+
+TEST(Delay, StagedGrowDropsRingWhenLineGrewMeanwhile)
+{
+  CDelay delay;
+  delay.Init(mSEC_TO_DELAY(1), 48000);
+
+  unsigned int pos = 0;
+  for (; pos < 1000; ++pos)
+    delay.Store((float)pos);
+
+  CDelay::sGrow grow;
+  ASSERT_TRUE(delay.BeginGrow(mSEC_TO_DELAY(15), grow));
+  CDelay::PrepareGrow(grow);
+  delay.SetDelay(mSEC_TO_DELAY(20));
+
+  /* the line grew on its own, the prepared ring comes back unused */
+  float *prepared = grow.pBuffer;
+  EXPECT_EQ(delay.CommitGrow(grow), prepared);
+  delete[] prepared;
+
+  for (unsigned int i = 0; i < 2000; ++i, ++pos)
+  {
+    delay.Store((float)pos);
+    float out = delay.Retrieve();
+    unsigned int source = pos - delay.GetLatency();
+    if (source >= 1000 - 64)
+      ASSERT_EQ(out, (float)source) << "sample " << pos;
+    else
+      ASSERT_TRUE(out == 0.0f || out == (float)source) << "sample " << pos;
+  }
+}
+
+TEST(Delay, PaddingAddsToLatency)
+{
+  CDelay delay;
+  delay.Init(mSEC_TO_DELAY(1), 48000);
+  delay.SetPadding(96);
+  EXPECT_EQ(delay.GetLatency(), 48u + 96u);
+  EXPECT_EQ(delay.GetPadding(), 96u);
+  EXPECT_EQ(ImpulsePosition(delay, 1000), 48u + 96u);
+
+  /* the padding stays when the line is set up again */
+  delay.Init(mSEC_TO_DELAY(2), 48000);
+  EXPECT_EQ(delay.GetLatency(), 96u + 96u);
+}
+
+TEST(Delay, FlushClearsLine)
+{
+  CDelay delay;
+  delay.Init(mSEC_TO_DELAY(1), 48000);
+  for (unsigned int pos = 0; pos < 100; ++pos)
+    delay.Store(1.0f);
+
+  delay.Flush();
+  for (unsigned int pos = 0; pos < 100; ++pos)
+  {
+    delay.Store(0.0f);
+    EXPECT_EQ(delay.Retrieve(), 0.0f);
+  }
+}
+
+TEST(Delay, FloatStorageIsTransparent)
+{
+  /* a line only stores and returns its samples, float storage returns a
+   * float stream bit exact to the double line */
+  std::vector<float> noise(48000);
+  cPinkNoise generator;
+  generator.Generate(&noise[0], noise.size());
+
+  CDelayT<float>  single;
+  CDelayT<double> reference;
+  single.Init(mSEC_TO_DELAY(15), 48000);
+  reference.Init(mSEC_TO_DELAY(15), 48000);
+
+  for (unsigned int pos = 0; pos < noise.size(); ++pos)
+  {
+    single.Store(noise[pos]);
+    reference.Store(noise[pos]);
+    ASSERT_EQ(single.Retrieve(), (float)reference.Retrieve()) << "sample " << pos;
+  }
+}
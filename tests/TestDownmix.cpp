@@ -0,0 +1,154 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Matrix sums of the stereo downmix master mode, every input channel has
+ * to reach the two outputs with its documented coefficients.
+ */
+
+#include <math.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Process_Stereo/DSPProcessStereo.h"
+
+#define TEST_SAMPLE_RATE  48000
+#define TEST_FRAMES       8192
+#define TEST_SETTLED      1024    //!< Samples after the Hilbert transformer is filled
+
+class DownmixTest : public ::testing::Test
+{
+protected:
+  DownmixTest()
+    : m_In(AE_DSP_CH_MAX, std::vector<float>(TEST_FRAMES, 0.0f))
+    , m_Out(AE_DSP_CH_MAX, std::vector<float>(TEST_FRAMES, 0.0f))
+    , m_Downmix(0)
+  {
+    memset(&m_Settings, 0, sizeof(m_Settings));
+    m_Settings.iInChannels              = 6;
+    m_Settings.lInChannelPresentFlags   = AE_DSP_PRSNT_CH_FL | AE_DSP_PRSNT_CH_FR | AE_DSP_PRSNT_CH_FC |
+                                          AE_DSP_PRSNT_CH_LFE | AE_DSP_PRSNT_CH_SL | AE_DSP_PRSNT_CH_SR;
+    m_Settings.iOutChannels             = 2;
+    m_Settings.lOutChannelPresentFlags  = AE_DSP_PRSNT_CH_FL | AE_DSP_PRSNT_CH_FR;
+    m_Settings.iProcessSamplerate       = TEST_SAMPLE_RATE;
+    m_Settings.iProcessFrames           = TEST_FRAMES;
+
+    for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+    {
+      m_InPtr[i]  = &m_In[i][0];
+      m_OutPtr[i] = &m_Out[i][0];
+    }
+  }
+
+  void Sine(AE_DSP_CHANNEL channel, double freq)
+  {
+    for (unsigned int pos = 0; pos < TEST_FRAMES; ++pos)
+      m_In[channel][pos] = (float)(0.5 * sin(2.0 * M_PI * freq * pos / TEST_SAMPLE_RATE));
+  }
+
+  void Process()
+  {
+    ASSERT_EQ(m_Downmix.Initialize(&m_Settings), AE_DSP_ERROR_NO_ERROR);
+    ASSERT_EQ(m_Downmix.Process(m_InPtr, m_OutPtr, TEST_FRAMES), (unsigned int)TEST_FRAMES);
+  }
+
+  /* output level relative to a 0.5 amplitude sine */
+  double Level(AE_DSP_CHANNEL channel)
+  {
+    double energy = 0.0;
+    for (unsigned int pos = TEST_SETTLED; pos < TEST_FRAMES; ++pos)
+      energy += (double)m_Out[channel][pos] * m_Out[channel][pos];
+    return sqrt(energy / (TEST_FRAMES - TEST_SETTLED)) / (0.5 * M_SQRT1_2);
+  }
+
+  AE_DSP_SETTINGS                  m_Settings;
+  std::vector<std::vector<float> > m_In;
+  std::vector<std::vector<float> > m_Out;
+  float                           *m_InPtr[AE_DSP_CH_MAX];
+  float                           *m_OutPtr[AE_DSP_CH_MAX];
+  CDSPProcess_StereoDownmix        m_Downmix;
+};
+
+TEST_F(DownmixTest, FrontChannelsPassThrough)
+{
+  Sine(AE_DSP_CH_FL, 1000.0);
+  Process();
+
+  EXPECT_NEAR(Level(AE_DSP_CH_FL), DM_GAIN * DM_FL, 1e-3);
+  EXPECT_NEAR(Level(AE_DSP_CH_FR), 0.0, 1e-6);
+  for (unsigned int pos = 0; pos < TEST_FRAMES; ++pos)
+    ASSERT_FLOAT_EQ(m_Out[AE_DSP_CH_FL][pos], m_In[AE_DSP_CH_FL][pos]);
+}
+
+TEST_F(DownmixTest, CenterKeepsPower)
+{
+  Sine(AE_DSP_CH_FC, 1000.0);
+  Process();
+
+  double left  = Level(AE_DSP_CH_FL);
+  double right = Level(AE_DSP_CH_FR);
+  EXPECT_NEAR(left, DM_CL, 1e-3);
+  EXPECT_NEAR(right, DM_CL, 1e-3);
+  EXPECT_NEAR(left * left + right * right, 1.0, 0.01);
+}
+
+TEST_F(DownmixTest, SurroundKeepsPower)
+{
+  /* the phase shifted surrounds go into both sides, the power sum is one */
+  const AE_DSP_CHANNEL surrounds[] = { AE_DSP_CH_SL, AE_DSP_CH_SR };
+  for (unsigned int i = 0; i < 2; ++i)
+  {
+    for (int ch = 0; ch < AE_DSP_CH_MAX; ++ch)
+      std::fill(m_In[ch].begin(), m_In[ch].end(), 0.0f);
+    Sine(surrounds[i], 1000.0);
+    Process();
+
+    double left  = Level(AE_DSP_CH_FL);
+    double right = Level(AE_DSP_CH_FR);
+    EXPECT_NEAR(left,  i == 0 ? DM_SLA : DM_SLB, 0.01);
+    EXPECT_NEAR(right, i == 0 ? DM_SLB : DM_SLA, 0.01);
+    EXPECT_NEAR(left * left + right * right, 1.0, 0.02);
+  }
+}
+
+TEST_F(DownmixTest, LFEFollowsFrontsWhenPresent)
+{
+  Sine(AE_DSP_CH_FL, 200.0);
+  Sine(AE_DSP_CH_FR, 200.0);
+  m_Settings.lOutChannelPresentFlags |= AE_DSP_PRSNT_CH_LFE;
+  Process();
+
+  for (unsigned int pos = 0; pos < TEST_FRAMES; ++pos)
+    ASSERT_FLOAT_EQ(m_Out[AE_DSP_CH_LFE][pos], 0.5f * (m_In[AE_DSP_CH_FL][pos] + m_In[AE_DSP_CH_FR][pos]));
+}
+
+TEST_F(DownmixTest, RegisteredForMultichannelToStereo)
+{
+  const sDSPMasterModeDescriptor *descriptor = CDSPMasterModeRegistry::Find(ID_MASTER_PROCESS_STEREO_DOWNMIX);
+  ASSERT_TRUE(descriptor != NULL);
+  EXPECT_TRUE(CDSPMasterModeRegistry::IsSupported(descriptor, &m_Settings, NULL));
+
+  m_Settings.iInChannels = 2;
+  EXPECT_FALSE(CDSPMasterModeRegistry::IsSupported(descriptor, &m_Settings, NULL));
+
+  m_Settings.iInChannels  = 6;
+  m_Settings.iOutChannels = 6;
+  EXPECT_FALSE(CDSPMasterModeRegistry::IsSupported(descriptor, &m_Settings, NULL));
+}
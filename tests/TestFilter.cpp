@@ -0,0 +1,219 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Impulse and step responses of the mkfilter designs run through Cfilter.
+ * The low pass is checked sample by sample against the bilinear transform
+ * of the analog Butterworth prototype. The float instantiation is checked
+ * against the double one for the designs of the speaker correction.
+ */
+
+#include <math.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "filter/mkfilter.h"
+#include "filter/filter.h"
+#include "PinkNoise.h"
+
+#define TEST_SAMPLE_RATE      48000
+#define TEST_RESPONSE_LENGTH  4800
+#define TEST_NOISE_FLOOR_DB   -135.0  //!< Error of float storage against double, below the float output resolution
+
+template <typename SAMPLE>
+static void Design(CfilterT<SAMPLE> &filter, filter_type_t type, filter_pass_t pass, int order,
+                   double freq1, double freq2, double qfactor = 0.0)
+{
+  int numzero;
+  int numpole;
+  double xcoeffs[MAXPZ+1];
+  double ycoeffs[MAXPZ+1];
+  double gain;
+
+  mkfilter(type, pass, order, freq1 / TEST_SAMPLE_RATE, freq2 / TEST_SAMPLE_RATE, 0.0,
+           &numzero, xcoeffs, &numpole, ycoeffs, &gain, qfactor);
+  filter.Config(numzero, xcoeffs, numpole, ycoeffs, gain);
+}
+
+static void Response(Cfilter &filter, float *out, unsigned int samples, bool step)
+{
+  for (unsigned int pos = 0; pos < samples; ++pos)
+    out[pos] = filter.GetNext(step || pos == 0 ? 1.0f : 0.0f);
+}
+
+static double SineGain(Cfilter &filter, double freq)
+{
+  /* amplitude after the filter has settled */
+  double peak = 0.0;
+  for (unsigned int pos = 0; pos < 4 * TEST_RESPONSE_LENGTH; ++pos)
+  {
+    double out = filter.GetNext((float)sin(2.0 * M_PI * freq * pos / TEST_SAMPLE_RATE));
+    if (pos >= 3 * TEST_RESPONSE_LENGTH && fabs(out) > peak)
+      peak = fabs(out);
+  }
+  return peak;
+}
+
+TEST(Filter, ButterworthLowPassMatchesBilinearPrototype)
+{
+  const double freq = 1000.0;
+
+  Cfilter filter;
+  Design(filter, BUTTERWORTH, LOW_PASS, 2, freq, 0.0);
+
+  /* H(s) = 1 / (s^2 + sqrt(2) s + 1) with prewarped cut off */
+  const double k    = tan(M_PI * freq / TEST_SAMPLE_RATE);
+  const double norm = 1.0 / (1.0 + M_SQRT2 * k + k * k);
+  const double b0   = k * k * norm;
+  const double b1   = 2.0 * b0;
+  const double b2   = b0;
+  const double a1   = 2.0 * (k * k - 1.0) * norm;
+  const double a2   = (1.0 - M_SQRT2 * k + k * k) * norm;
+
+  double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
+  for (unsigned int pos = 0; pos < TEST_RESPONSE_LENGTH; ++pos)
+  {
+    double x = pos == 0 ? 1.0 : 0.0;
+    double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+    x2 = x1; x1 = x;
+    y2 = y1; y1 = y;
+
+    ASSERT_NEAR(filter.GetNext((float)x), y, 1e-6) << "sample " << pos;
+  }
+}
+
+TEST(Filter, LowPassStepSettlesAtUnity)
+{
+  float out[TEST_RESPONSE_LENGTH];
+  for (int order = 1; order <= 4; ++order)
+  {
+    Cfilter filter;
+    Design(filter, BUTTERWORTH, LOW_PASS, order, 500.0, 0.0);
+    Response(filter, out, TEST_RESPONSE_LENGTH, true);
+    EXPECT_NEAR(out[TEST_RESPONSE_LENGTH - 1], 1.0f, 1e-4) << "order " << order;
+  }
+}
+
+TEST(Filter, LowPassImpulseSumsToDCGain)
+{
+  float out[TEST_RESPONSE_LENGTH];
+  Cfilter filter;
+  Design(filter, BESSEL, LOW_PASS, 4, 2000.0, 0.0);
+  Response(filter, out, TEST_RESPONSE_LENGTH, false);
+
+  double sum = 0.0;
+  for (unsigned int pos = 0; pos < TEST_RESPONSE_LENGTH; ++pos)
+    sum += out[pos];
+  EXPECT_NEAR(sum, 1.0, 1e-4);
+}
+
+TEST(Filter, HighPassStepDecaysToZero)
+{
+  float out[TEST_RESPONSE_LENGTH];
+  Cfilter filter;
+  Design(filter, BUTTERWORTH, HIGH_PASS, 2, 200.0, 0.0);
+  Response(filter, out, TEST_RESPONSE_LENGTH, true);
+
+  EXPECT_NEAR(out[0], 1.0f, 0.05f);
+  EXPECT_NEAR(out[TEST_RESPONSE_LENGTH - 1], 0.0f, 1e-4);
+}
+
+TEST(Filter, BandPassHasUnityGainAtCenter)
+{
+  Cfilter filter;
+  Design(filter, BUTTERWORTH, BAND_PASS, 2, 500.0, 2000.0);
+
+  /* the pass band gain is normalized at the geometric center */
+  EXPECT_NEAR(SineGain(filter, 1000.0), 1.0, 0.01);
+
+  Cfilter stop;
+  Design(stop, BUTTERWORTH, BAND_PASS, 2, 500.0, 2000.0);
+  EXPECT_LT(SineGain(stop, 16000.0), 0.05);
+}
+
+TEST(Filter, AllPassResonatorKeepsEnergy)
+{
+  /* |H| = 1 everywhere, so the impulse response has the energy of the impulse */
+  float out[TEST_RESPONSE_LENGTH];
+  Cfilter filter;
+  Design(filter, RESONATOR, ALL_PASS, 2, 100.0, 0.0, 0.71);
+  Response(filter, out, TEST_RESPONSE_LENGTH, false);
+
+  double energy = 0.0;
+  for (unsigned int pos = 0; pos < TEST_RESPONSE_LENGTH; ++pos)
+    energy += (double)out[pos] * out[pos];
+  EXPECT_NEAR(energy, 1.0, 1e-3);
+}
+
+TEST(Filter, FlushClearsHistory)
+{
+  float out[TEST_RESPONSE_LENGTH];
+  Cfilter filter;
+  Design(filter, BUTTERWORTH, LOW_PASS, 4, 100.0, 0.0);
+  Response(filter, out, 100, true);
+
+  filter.Flush();
+  for (unsigned int pos = 0; pos < 100; ++pos)
+    EXPECT_NEAR(filter.GetNext(0.0f), 0.0f, 1e-12f) << "sample " << pos;
+}
+
+TEST(Filter, FloatStorageIsTransparent)
+{
+  struct sDesign
+  {
+    filter_type_t type;
+    filter_pass_t pass;
+    double        freq1;
+    double        freq2;
+    double        qfactor;
+  };
+  const sDesign designs[] =
+  {
+    { RESONATOR,   ALL_PASS,  60.0,   0.0,    5.0 },
+    { RESONATOR,   ALL_PASS,  1000.0, 0.0,    0.7 },
+    { BUTTERWORTH, BAND_PASS, 30.0,   120.0,  0.0 },
+  };
+
+  std::vector<float> noise(10 * TEST_SAMPLE_RATE);
+  cPinkNoise generator;
+  generator.Generate(&noise[0], noise.size());
+
+  for (unsigned int d = 0; d < sizeof(designs) / sizeof(designs[0]); ++d)
+  {
+    const sDesign &design = designs[d];
+    CfilterT<float>  single;
+    CfilterT<double> reference;
+    Design(single, design.type, design.pass, 2, design.freq1, design.freq2, design.qfactor);
+    Design(reference, design.type, design.pass, 2, design.freq1, design.freq2, design.qfactor);
+
+    double signal = 0.0;
+    double error  = 0.0;
+    for (unsigned int pos = 0; pos < noise.size(); ++pos)
+    {
+      double out  = reference.GetNext(noise[pos]);
+      double diff = single.GetNext(noise[pos]) - out;
+      signal += out * out;
+      error  += diff * diff;
+    }
+
+    double floorDB = 10.0 * log10(error / signal);
+    EXPECT_LT(floorDB, TEST_NOISE_FLOOR_DB) << "design " << d << " at " << floorDB << " dB";
+  }
+}
@@ -0,0 +1,274 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Timing budgets of the per sample kernels. Every kernel runs a few times
+ * over one second of audio, the fastest run is compared against its budget
+ * in nanoseconds per sample. The budgets carry a band of PERF_BAND over the
+ * time measured on the reference machine, ADSP_PERF_TOLERANCE in the
+ * environment scales them further for slow or loaded machines.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include "filter/mkfilter.h"
+#include "filter/filter.h"
+#include "filter/delay.h"
+#include "filter/denormal.h"
+#include "filter/softclamp.h"
+#include "Process_Stereo/DSPProcessStereo.h"
+#include "PinkNoise.h"
+
+#define TEST_SAMPLE_RATE  48000
+#define TEST_RUNS         5
+#define PERF_BAND         4.0     //!< Allowed factor over the reference time
+
+/* reference times in nanoseconds per sample of one channel, optimized build */
+#define PERF_REF_FILTER   8.0     //!< 4th order Butterworth
+#define PERF_REF_DELAY    2.0
+#define PERF_REF_CLAMP    1.0     //!< Signal partly above the knee
+#define PERF_REF_DOWNMIX  75.0    //!< Per frame of 5.1 input, Hilbert transform included
+#define PERF_REF_NOISE    3.5     //!< Slower of the two methods
+#define PERF_REF_LINES    8.0     //!< All-pass and delay line of a second, float storage
+#define PERF_REF_TAIL     7.5     //!< 2nd order high-pass, mostly on silence
+
+#define PERF_CORRECTION_CHANNELS  12      //!< 7.1.4
+#define PERF_BLOCK                480     //!< Samples per channel and call, 10 ms
+
+static double Tolerance()
+{
+  const char *value = getenv("ADSP_PERF_TOLERANCE");
+  double tolerance = value ? atof(value) : 1.0;
+  return tolerance > 0.0 ? tolerance : 1.0;
+}
+
+template <typename KERNEL>
+static double NanosecondsPerSample(KERNEL kernel, unsigned int samples)
+{
+  double best = 0.0;
+  for (int run = 0; run < TEST_RUNS; ++run)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    kernel();
+    std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+    if (run == 0 || time.count() < best)
+      best = time.count();
+  }
+  return best / samples;
+}
+
+static void ExpectWithinBudget(const char *kernel, double measured, double reference)
+{
+  double budget = reference * PERF_BAND * Tolerance();
+  ::testing::Test::RecordProperty(kernel, (int)(measured * 1000.0));
+  EXPECT_LE(measured, budget) << kernel << " takes " << measured << " ns per sample, budget " << budget;
+}
+
+template <typename SAMPLE>
+static void Design(CfilterT<SAMPLE> &filter, filter_type_t type, filter_pass_t pass, int order, double freq, double qfactor = 0.0)
+{
+  int numzero;
+  int numpole;
+  double xcoeffs[MAXPZ+1];
+  double ycoeffs[MAXPZ+1];
+  double gain;
+  mkfilter(type, pass, order, freq / TEST_SAMPLE_RATE, 0.0, 0.0,
+           &numzero, xcoeffs, &numpole, ycoeffs, &gain, qfactor);
+  filter.Config(numzero, xcoeffs, numpole, ycoeffs, gain);
+}
+
+/*!
+ * Speaker correction of a large layout block by block, every channel with
+ * an all-pass and a delay line of a second. The delay lines are the memory
+ * the sample type of the precision policy decides on.
+ */
+template <typename SAMPLE>
+static double CorrectionTime(const std::vector<float> &signal)
+{
+  CfilterT<SAMPLE> allPass[PERF_CORRECTION_CHANNELS];
+  CDelayT<SAMPLE> delay[PERF_CORRECTION_CHANNELS];
+  for (unsigned int ch = 0; ch < PERF_CORRECTION_CHANNELS; ++ch)
+  {
+    Design(allPass[ch], RESONATOR, ALL_PASS, 2, 100.0, 0.71);
+    delay[ch].Init(mSEC_TO_DELAY(1000), TEST_SAMPLE_RATE);
+  }
+
+  std::vector<float> out(signal.size());
+  return NanosecondsPerSample([&]()
+  {
+    for (unsigned int block = 0; block < signal.size(); block += PERF_BLOCK)
+    {
+      unsigned int end = block + PERF_BLOCK < signal.size() ? block + PERF_BLOCK : signal.size();
+      for (unsigned int ch = 0; ch < PERF_CORRECTION_CHANNELS; ++ch)
+      {
+        for (unsigned int pos = block; pos < end; ++pos)
+        {
+          delay[ch].Store(allPass[ch].GetNext(signal[pos]));
+          out[pos] = (float)delay[ch].Retrieve();
+        }
+      }
+    }
+  }, signal.size() * PERF_CORRECTION_CHANNELS);
+}
+
+class PerformanceTest : public ::testing::Test
+{
+protected:
+  PerformanceTest()
+    : m_Signal(TEST_SAMPLE_RATE)
+  {
+    cPinkNoise noise;
+    noise.Generate(&m_Signal[0], m_Signal.size());
+  }
+
+  std::vector<float> m_Signal;    //!< One second of pink noise
+};
+
+TEST_F(PerformanceTest, Filter)
+{
+  Cfilter filter;
+  Design(filter, BUTTERWORTH, LOW_PASS, 4, 1000.0);
+
+  std::vector<float> out(m_Signal.size());
+  double time = NanosecondsPerSample([&]()
+  {
+    for (unsigned int pos = 0; pos < m_Signal.size(); ++pos)
+      out[pos] = filter.GetNext(m_Signal[pos]);
+  }, m_Signal.size());
+  ExpectWithinBudget("filter", time, PERF_REF_FILTER);
+}
+
+TEST_F(PerformanceTest, Delay)
+{
+  CDelay delay;
+  delay.Init(mSEC_TO_DELAY(15), TEST_SAMPLE_RATE);
+
+  std::vector<float> out(m_Signal.size());
+  double time = NanosecondsPerSample([&]()
+  {
+    for (unsigned int pos = 0; pos < m_Signal.size(); ++pos)
+    {
+      delay.Store(m_Signal[pos]);
+      out[pos] = delay.Retrieve();
+    }
+  }, m_Signal.size());
+  ExpectWithinBudget("delay", time, PERF_REF_DELAY);
+}
+
+TEST_F(PerformanceTest, CorrectionBandwidth)
+{
+  /* the double line is measured for comparison, the budget is for float */
+  double single    = CorrectionTime<float>(m_Signal);
+  double reference = CorrectionTime<double>(m_Signal);
+  RecordProperty("correction double", (int)(reference * 1000.0));
+  ExpectWithinBudget("correction float", single, PERF_REF_LINES);
+}
+
+TEST_F(PerformanceTest, SilenceTail)
+{
+  /* the recursive state decays towards the denormal range on the silence
+   * after the noise, the feedback offset keeps it out also without the guard */
+  std::vector<float> input(10 * m_Signal.size(), 0.0f);
+  std::copy(m_Signal.begin(), m_Signal.end(), input.begin());
+
+  Cfilter filter;
+  Design(filter, BUTTERWORTH, HIGH_PASS, 2, 100.0);
+
+  std::vector<float> out(input.size());
+  auto kernel = [&]()
+  {
+    filter.Flush();
+    for (unsigned int pos = 0; pos < input.size(); ++pos)
+      out[pos] = filter.GetNext(input[pos]);
+  };
+
+  double plain = NanosecondsPerSample(kernel, input.size());
+  double guarded;
+  {
+    CDenormalGuard denormalGuard;
+    guarded = NanosecondsPerSample(kernel, input.size());
+  }
+  ExpectWithinBudget("silence tail", plain, PERF_REF_TAIL);
+  ExpectWithinBudget("silence tail guarded", guarded, PERF_REF_TAIL);
+}
+
+TEST_F(PerformanceTest, SoftClamp)
+{
+  std::vector<float> out(m_Signal.size());
+  double time = NanosecondsPerSample([&]()
+  {
+    for (unsigned int pos = 0; pos < m_Signal.size(); ++pos)
+      out[pos] = SoftClamp(2.0f * m_Signal[pos]);
+  }, m_Signal.size());
+  ExpectWithinBudget("soft clamp", time, PERF_REF_CLAMP);
+}
+
+TEST_F(PerformanceTest, StereoDownmix)
+{
+  AE_DSP_SETTINGS settings;
+  memset(&settings, 0, sizeof(settings));
+  settings.iInChannels              = 6;
+  settings.lInChannelPresentFlags   = AE_DSP_PRSNT_CH_FL | AE_DSP_PRSNT_CH_FR | AE_DSP_PRSNT_CH_FC |
+                                      AE_DSP_PRSNT_CH_LFE | AE_DSP_PRSNT_CH_SL | AE_DSP_PRSNT_CH_SR;
+  settings.iOutChannels             = 2;
+  settings.lOutChannelPresentFlags  = AE_DSP_PRSNT_CH_FL | AE_DSP_PRSNT_CH_FR;
+  settings.iProcessSamplerate       = TEST_SAMPLE_RATE;
+
+  CDSPProcess_StereoDownmix downmix(0);
+  ASSERT_EQ(downmix.Initialize(&settings), AE_DSP_ERROR_NO_ERROR);
+
+  std::vector<std::vector<float> > in(AE_DSP_CH_MAX, m_Signal);
+  std::vector<std::vector<float> > out(AE_DSP_CH_MAX, std::vector<float>(m_Signal.size()));
+  float *inPtr[AE_DSP_CH_MAX];
+  float *outPtr[AE_DSP_CH_MAX];
+  for (int i = 0; i < AE_DSP_CH_MAX; ++i)
+  {
+    inPtr[i]  = &in[i][0];
+    outPtr[i] = &out[i][0];
+  }
+
+  double time = NanosecondsPerSample([&]()
+  {
+    downmix.Process(inPtr, outPtr, m_Signal.size());
+  }, m_Signal.size());
+  ExpectWithinBudget("stereo downmix", time, PERF_REF_DOWNMIX);
+}
+
+TEST_F(PerformanceTest, PinkNoise)
+{
+  const int methods[] = { PINK_NOISE_VOSS_MCCARTNEY, PINK_NOISE_KELLET };
+  const char *names[] = { "pink noise voss-mccartney", "pink noise kellet" };
+
+  std::vector<float> out(m_Signal.size());
+  for (unsigned int m = 0; m < 2; ++m)
+  {
+    cPinkNoise noise(PINK_NOISE_DEFAULT_SEED, methods[m]);
+    double time = NanosecondsPerSample([&]()
+    {
+      noise.Generate(&out[0], out.size());
+    }, out.size());
+    ExpectWithinBudget(names[m], time, PERF_REF_NOISE);
+  }
+}
@@ -0,0 +1,159 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Spectrum of the pink noise generators, the power has to fall by 3 dB per
+ * octave over the audio band. The spectrum is averaged over Hann windowed
+ * FFT frames and reduced to octave bands before the slope is fitted.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "PinkNoise.h"
+#include "filter/fft.h"
+
+#define TEST_SAMPLE_RATE    48000
+#define TEST_FFT_SIZE       4096
+#define TEST_FFT_FRAMES     512
+#define TEST_BAND_LOW       62.5      //!< Hz, lower edge of the first octave
+#define TEST_BANDS          8         //!< Up to 16 kHz
+
+static double SpectrumSlope(int method)
+{
+  cPinkNoise noise(PINK_NOISE_DEFAULT_SEED, method);
+  CFFT fft;
+  fft.Init(TEST_FFT_SIZE);
+
+  std::vector<float>  block(TEST_FFT_SIZE);
+  std::vector<double> re(TEST_FFT_SIZE);
+  std::vector<double> im(TEST_FFT_SIZE);
+  std::vector<double> power(TEST_FFT_SIZE / 2, 0.0);
+
+  for (unsigned int frame = 0; frame < TEST_FFT_FRAMES; ++frame)
+  {
+    noise.Generate(&block[0], TEST_FFT_SIZE);
+    for (unsigned int i = 0; i < TEST_FFT_SIZE; ++i)
+    {
+      re[i] = block[i] * (0.5 - 0.5 * cos(2.0 * M_PI * i / TEST_FFT_SIZE));
+      im[i] = 0.0;
+    }
+    fft.Forward(&re[0], &im[0]);
+    for (unsigned int i = 0; i < TEST_FFT_SIZE / 2; ++i)
+      power[i] += re[i] * re[i] + im[i] * im[i];
+  }
+
+  /* least squares line through the band levels over the octave number */
+  double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumXY = 0.0;
+  for (int band = 0; band < TEST_BANDS; ++band)
+  {
+    double low  = TEST_BAND_LOW * pow(2.0, band);
+    unsigned int first = (unsigned int)ceil(low * TEST_FFT_SIZE / TEST_SAMPLE_RATE);
+    unsigned int last  = (unsigned int)(2.0 * low * TEST_FFT_SIZE / TEST_SAMPLE_RATE);
+
+    double bandPower = 0.0;
+    for (unsigned int i = first; i < last; ++i)
+      bandPower += power[i];
+    double level = 10.0 * log10(bandPower / (last - first));
+
+    sumX  += band;
+    sumY  += level;
+    sumXX += band * band;
+    sumXY += band * level;
+  }
+  return (TEST_BANDS * sumXY - sumX * sumY) / (TEST_BANDS * sumXX - sumX * sumX);
+}
+
+TEST(PinkNoise, VossMcCartneySlope)
+{
+  EXPECT_NEAR(SpectrumSlope(PINK_NOISE_VOSS_MCCARTNEY), -3.01, 0.5);
+}
+
+TEST(PinkNoise, KelletSlope)
+{
+  EXPECT_NEAR(SpectrumSlope(PINK_NOISE_KELLET), -3.01, 0.3);
+}
+
+TEST(PinkNoise, SeedIsReproducible)
+{
+  float a[1024];
+  float b[1024];
+  float c[1024];
+
+  cPinkNoise first(1234);
+  cPinkNoise second(1234);
+  cPinkNoise other(4321);
+  first.Generate(a, 1024);
+  second.Generate(b, 1024);
+  other.Generate(c, 1024);
+
+  EXPECT_EQ(memcmp(a, b, sizeof(a)), 0);
+  EXPECT_NE(memcmp(a, c, sizeof(a)), 0);
+}
+
+TEST(PinkNoise, StaysInRange)
+{
+  const int methods[] = { PINK_NOISE_VOSS_MCCARTNEY, PINK_NOISE_KELLET };
+  for (unsigned int m = 0; m < 2; ++m)
+  {
+    cPinkNoise noise(PINK_NOISE_DEFAULT_SEED, methods[m]);
+    std::vector<float> block(TEST_SAMPLE_RATE * 10);
+    noise.Generate(&block[0], block.size());
+
+    double mean = 0.0;
+    for (unsigned int i = 0; i < block.size(); ++i)
+    {
+      ASSERT_LE(fabsf(block[i]), 1.0f) << "method " << methods[m];
+      mean += block[i];
+    }
+    EXPECT_NEAR(mean / block.size(), 0.0, 0.05) << "method " << methods[m];
+  }
+}
+
+TEST(PinkNoise, GenerateMatchesGetValue)
+{
+  float block[1024];
+
+  cPinkNoise blockNoise(1234);
+  cPinkNoise sampleNoise(1234);
+  blockNoise.Generate(block, 1024);
+  for (unsigned int i = 0; i < 1024; ++i)
+    ASSERT_EQ(block[i], sampleNoise.getValue()) << "sample " << i;
+}
+
+TEST(PinkNoise, MethodsHaveSameLevel)
+{
+  /* the Voss-McCartney sum of uniform generators has a stationary RMS of
+   * 1 / sqrt(3 * n_generators), its short term level wanders with the slow
+   * generators, so the filter bank is compared against the expected value */
+  cPinkNoise noise(PINK_NOISE_DEFAULT_SEED, PINK_NOISE_KELLET);
+  std::vector<float> block(TEST_SAMPLE_RATE * 10);
+  noise.Generate(&block[0], block.size());
+
+  double power = 0.0;
+  for (unsigned int i = 0; i < block.size(); ++i)
+    power += block[i] * block[i];
+  double rms = sqrt(power / block.size());
+
+  /* within 0.5 dB */
+  EXPECT_NEAR(20.0 * log10(rms * sqrt(3.0 * n_generators)), 0.0, 0.5);
+}
@@ -0,0 +1,77 @@
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * The soft clamp must not add a step or a kink the ear could hear, it is
+ * the identity below the knee and bends smoothly to full scale above.
+ */
+
+#include <math.h>
+
+#include <gtest/gtest.h>
+
+#include "filter/softclamp.h"
+
+#define TEST_STEP   1e-4f
+
+TEST(SoftClamp, IdentityBelowKnee)
+{
+  int steps = (int)(SOFT_CLAMP_KNEE / TEST_STEP);
+  for (int i = -steps; i <= steps; ++i)
+  {
+    float x = i * TEST_STEP;
+    ASSERT_EQ(SoftClamp(x), x);
+  }
+}
+
+TEST(SoftClamp, BoundedAndOdd)
+{
+  for (int i = -80000; i <= 80000; i += 10)
+  {
+    float x = i * TEST_STEP;
+    ASSERT_LE(fabsf(SoftClamp(x)), 1.0f) << "x " << x;
+    ASSERT_FLOAT_EQ(SoftClamp(-x), -SoftClamp(x)) << "x " << x;
+  }
+  EXPECT_NEAR(SoftClamp(8.0f), 1.0f, 1e-6f);
+}
+
+TEST(SoftClamp, ContinuousAndMonotonic)
+{
+  /* no sample to sample change larger than the input step */
+  float last = SoftClamp(-4.0f);
+  for (int i = -39999; i <= 40000; ++i)
+  {
+    float x = i * TEST_STEP;
+    float y = SoftClamp(x);
+    ASSERT_GE(y, last) << "x " << x;
+    ASSERT_LE(y - last, TEST_STEP * 1.01f) << "x " << x;
+    last = y;
+  }
+}
+
+TEST(SoftClamp, SlopeContinuousAtKnee)
+{
+  const float knee  = (float)SOFT_CLAMP_KNEE;
+  const float delta = 1e-3f;
+
+  float below = (SoftClamp(knee) - SoftClamp(knee - delta)) / delta;
+  float above = (SoftClamp(knee + delta) - SoftClamp(knee)) / delta;
+  EXPECT_NEAR(below, 1.0f, 0.01f);
+  EXPECT_NEAR(above, 1.0f, 0.02f);
+}
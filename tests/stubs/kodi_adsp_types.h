@@ -0,0 +1,192 @@
+#pragma once
+/*
+ *      Copyright (C) 2014-2015 Team KODI
+ *      http://kodi.tv
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/*
+ * Subset of the KODI audio DSP add-on types the DSP code under test uses,
+ * so the tests build without the KODI headers. Names and values follow
+ * xbmc/addons/kodi-addon-dev-kit/include/kodi/kodi_adsp_types.h.
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+#define AE_DSP_ADDON_STRING_LENGTH      1024
+#define AE_DSP_STREAM_MAX_STREAMS       8
+
+typedef unsigned int AE_DSP_STREAM_ID;
+
+typedef enum
+{
+  AE_DSP_ERROR_NO_ERROR               = 0,
+  AE_DSP_ERROR_UNKNOWN                = -1,
+  AE_DSP_ERROR_IGNORE_ME              = -2,
+  AE_DSP_ERROR_NOT_IMPLEMENTED        = -3,
+  AE_DSP_ERROR_REJECTED               = -4,
+  AE_DSP_ERROR_INVALID_PARAMETERS     = -5,
+  AE_DSP_ERROR_INVALID_SAMPLERATE     = -6,
+  AE_DSP_ERROR_INVALID_IN_CHANNELS    = -7,
+  AE_DSP_ERROR_INVALID_OUT_CHANNELS   = -8,
+  AE_DSP_ERROR_FAILED                 = -9
+} AE_DSP_ERROR;
+
+typedef enum
+{
+  AE_DSP_CH_INVALID = -1,
+  AE_DSP_CH_FL = 0,
+  AE_DSP_CH_FR,
+  AE_DSP_CH_FC,
+  AE_DSP_CH_LFE,
+  AE_DSP_CH_BL,
+  AE_DSP_CH_BR,
+  AE_DSP_CH_FLOC,
+  AE_DSP_CH_FROC,
+  AE_DSP_CH_BC,
+  AE_DSP_CH_SL,
+  AE_DSP_CH_SR,
+  AE_DSP_CH_TFL,
+  AE_DSP_CH_TFR,
+  AE_DSP_CH_TFC,
+  AE_DSP_CH_TC,
+  AE_DSP_CH_TBL,
+  AE_DSP_CH_TBR,
+  AE_DSP_CH_TBC,
+  AE_DSP_CH_BLOC,
+  AE_DSP_CH_BROC,
+
+  AE_DSP_CH_MAX
+} AE_DSP_CHANNEL;
+
+typedef enum
+{
+  AE_DSP_PRSNT_CH_UNDEFINED = 0,
+  AE_DSP_PRSNT_CH_FL        = 1<<0,
+  AE_DSP_PRSNT_CH_FR        = 1<<1,
+  AE_DSP_PRSNT_CH_FC        = 1<<2,
+  AE_DSP_PRSNT_CH_LFE       = 1<<3,
+  AE_DSP_PRSNT_CH_BL        = 1<<4,
+  AE_DSP_PRSNT_CH_BR        = 1<<5,
+  AE_DSP_PRSNT_CH_FLOC      = 1<<6,
+  AE_DSP_PRSNT_CH_FROC      = 1<<7,
+  AE_DSP_PRSNT_CH_BC        = 1<<8,
+  AE_DSP_PRSNT_CH_SL        = 1<<9,
+  AE_DSP_PRSNT_CH_SR        = 1<<10,
+  AE_DSP_PRSNT_CH_TFL       = 1<<11,
+  AE_DSP_PRSNT_CH_TFR       = 1<<12,
+  AE_DSP_PRSNT_CH_TFC       = 1<<13,
+  AE_DSP_PRSNT_CH_TC        = 1<<14,
+  AE_DSP_PRSNT_CH_TBL       = 1<<15,
+  AE_DSP_PRSNT_CH_TBR       = 1<<16,
+  AE_DSP_PRSNT_CH_TBC       = 1<<17,
+  AE_DSP_PRSNT_CH_BLOC      = 1<<18,
+  AE_DSP_PRSNT_CH_BROC      = 1<<19
+} AE_DSP_CHANNEL_PRESENT;
+
+typedef enum
+{
+  AE_DSP_ASTREAM_INVALID = -1,
+  AE_DSP_ASTREAM_BASIC = 0,
+  AE_DSP_ASTREAM_MUSIC,
+  AE_DSP_ASTREAM_MOVIE,
+  AE_DSP_ASTREAM_GAME,
+  AE_DSP_ASTREAM_APP,
+  AE_DSP_ASTREAM_PHONE,
+  AE_DSP_ASTREAM_MESSAGE,
+
+  AE_DSP_ASTREAM_AUTO,
+  AE_DSP_ASTREAM_MAX
+} AE_DSP_STREAMTYPE;
+
+typedef enum
+{
+  AE_DSP_PRSNT_ASTREAM_BASIC    = 1<<0,
+  AE_DSP_PRSNT_ASTREAM_MUSIC    = 1<<1,
+  AE_DSP_PRSNT_ASTREAM_MOVIE    = 1<<2,
+  AE_DSP_PRSNT_ASTREAM_GAME     = 1<<3,
+  AE_DSP_PRSNT_ASTREAM_APP      = 1<<4,
+  AE_DSP_PRSNT_ASTREAM_MESSAGE  = 1<<5,
+  AE_DSP_PRSNT_ASTREAM_PHONE    = 1<<6
+} AE_DSP_ASTREAM_PRESENT;
+
+typedef enum
+{
+  AE_DSP_MODE_TYPE_UNDEFINED       = -1,
+  AE_DSP_MODE_TYPE_INPUT_RESAMPLE  = 0,
+  AE_DSP_MODE_TYPE_PRE_PROCESS     = 1,
+  AE_DSP_MODE_TYPE_MASTER_PROCESS  = 2,
+  AE_DSP_MODE_TYPE_POST_PROCESS    = 3,
+  AE_DSP_MODE_TYPE_OUTPUT_RESAMPLE = 4,
+  AE_DSP_MODE_TYPE_MAX             = 5
+} AE_DSP_MODE_TYPE;
+
+typedef struct AE_DSP_SETTINGS
+{
+  AE_DSP_STREAM_ID  iStreamID;
+  AE_DSP_STREAMTYPE iStreamType;
+  int               iInChannels;
+  unsigned long     lInChannelPresentFlags;
+  int               iInFrames;
+  unsigned int      iInSamplerate;
+  int               iProcessFrames;
+  unsigned int      iProcessSamplerate;
+  int               iOutChannels;
+  unsigned long     lOutChannelPresentFlags;
+  int               iOutFrames;
+  unsigned int      iOutSamplerate;
+  bool              bInputResamplingActive;
+  bool              bStereoUpmix;
+  int               iQualityLevel;
+} AE_DSP_SETTINGS;
+
+typedef struct AE_DSP_STREAM_PROPERTIES
+{
+  AE_DSP_STREAM_ID  iStreamID;
+  AE_DSP_STREAMTYPE iStreamType;
+  int               iBaseType;
+  const char       *strName;
+  const char       *strCodecId;
+  const char       *strLanguage;
+  int               iIdentifier;
+  int               iChannels;
+  int               iSampleRate;
+  int               iProfile;
+} AE_DSP_STREAM_PROPERTIES;
+
+typedef struct AE_DSP_MODES
+{
+  typedef struct AE_DSP_MODE
+  {
+    int               iUniqueDBModeId;
+    AE_DSP_MODE_TYPE  iModeType;
+    char              strModeName[AE_DSP_ADDON_STRING_LENGTH];
+
+    unsigned int      iModeNumber;
+    unsigned int      iModeSupportTypeFlags;
+    bool              bHasSettingsDialog;
+    bool              bIsDisabled;
+
+    unsigned int      iModeName;
+    unsigned int      iModeSetupName;
+    unsigned int      iModeDescription;
+    unsigned int      iModeHelp;
+
+    char              strOwnModeImage[AE_DSP_ADDON_STRING_LENGTH];
+    char              strOverrideModeImage[AE_DSP_ADDON_STRING_LENGTH];
+  } AE_DSP_MODE;
+} AE_DSP_MODES;